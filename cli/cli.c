@@ -26,44 +26,211 @@
  */
 
 #include "cli.h"
+#include "cli_esc_table.h"
 
 #define LEN_PROMPT 2           // length in printable chars
 const char prompt[] = "\r> ";  // update LEN_PROMPT as well
 
-char white_spaces[LEN_STD_STR + LEN_PROMPT] = { 0 };
-
 tCli *p_cli;    // passed by application, which must have allocated it
 
+static tCli *p_uart = NULL;                     // session served by CliRxISR/CliTxISR
+static tCli *sessions[CLI_MAX_SESSIONS] = { 0 };
+static char is_shared_init = 0;                 // commands counted, macros loaded
+
+#if CLI_CFG_MACROS
+/* Macros are packed as "name\0body\0name\0body\0...\0" (empty name ends the list) */
+static char macro_pool[CLI_MACRO_POOL_SIZE] = { 0 };
+#endif
+
+static unsigned num_commands = 0;         // counted once in CliInit
+static char are_commands_sorted = 0;      // root table may be unsorted, group tables may not
+
+static int CliIsSorted(const tCmd *table, unsigned num)
+{
+    for (unsigned i = 1; i < num; ++i)
+    {
+        if (strcmp(table[i - 1].handle, table[i].handle) >= 0)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+#if CLI_CFG_DEBUG && CLI_CFG_GROUPS
+static void CliCheckGroups(const tCmd *table, unsigned num)
+{
+    for (unsigned i = 0; i < num; ++i)
+    {
+        if (table[i].children)
+        {
+            if (!CliIsSorted(table[i].children, table[i].num_children))
+            {
+                CliSendString("\r\nunsorted group: ");
+                CliSendString(table[i].handle);
+            }
+
+            CliCheckGroups(table[i].children, table[i].num_children);
+        }
+    }
+}
+#endif
+
 int CliInit(tCli *p_cli_arg)
 {
     p_cli = p_cli_arg;
-
-    p_cli->idx = 0;
-    p_cli->was_input_received = 0;
+    p_uart = p_cli_arg;
 
     p_cli->rx_reg_addr = RX_REG_ADDR;
     p_cli->tx_reg_addr = TX_REG_ADDR;
+    p_cli->transport = NULL;
 
     p_cli->EnableUartInt = CliEnableUartInt;
     p_cli->DisableUartInt = CliDisableUartInt;
 
+    p_cli->LineReady = CliLineReady;
+    p_cli->TxIdle = CliTxIdle;
+
+#if CLI_CFG_MACROS
+    p_cli->StoreMacros = CliStoreMacros;
+    p_cli->LoadMacros = CliLoadMacros;
+#endif
+
     CliInitUart();
 
-    memset(p_cli->output_buffer, 0, NUM_OUT_MSG_QUEUE*sizeof(char*));
+    return CliAddSession(p_cli);
+}
+
+static void CliInitShared(void)
+{
+    for (num_commands = 0; commands[num_commands].handle[0]; ++num_commands);
+    are_commands_sorted = CliIsSorted(commands, num_commands);
+
+#if CLI_CFG_DEBUG && CLI_CFG_GROUPS
+    CliCheckGroups(commands, num_commands);
+#endif
+
+#if CLI_CFG_MACROS
+    if (!p_cli->LoadMacros || p_cli->LoadMacros(macro_pool, CLI_MACRO_POOL_SIZE))
+    {
+        memset(macro_pool, 0, CLI_MACRO_POOL_SIZE);
+    }
+    macro_pool[CLI_MACRO_POOL_SIZE - 1] = 0;
+#endif
+
+    is_shared_init = 1;
+}
+
+int CliAddSession(tCli *p_session)
+{
+    tCli *prev = p_cli;
+    unsigned i = 0;
+
+    for (i = 0; i < CLI_MAX_SESSIONS && sessions[i] && sessions[i] != p_session; ++i);
+    if (i == CLI_MAX_SESSIONS)
+    {
+        return -1;
+    }
+
+    p_session->idx = 0;
+    p_session->line[0] = 0;
+    p_session->was_input_received = 0;
+#if CLI_CFG_COMPLETION
+    p_session->is_listing = 0;
+#endif
+#if CLI_CFG_HISTORY
+    p_session->history_len = 0;
+    p_session->history_pos = 0;
+#endif
+#if CLI_CFG_LATENCY
+    p_session->t_line = 0;
+    p_session->last_latency = 0;
+    p_session->max_latency = 0;
+    p_session->rx_byte_max = 0;
+    p_session->tx_byte_max = 0;
+    p_session->over_budget = 0;
+#endif
+
+    p_session->out_head = 0;
+    p_session->out_tail = 0;
+    p_session->tx_buffer = NULL;
+    p_session->tx_char_idx = 0;
+    p_session->arena_used = 0;
+    p_session->arena_hwm = 0;
+    p_session->rx_drops = 0;
+    p_session->tx_drops = 0;
+#if CLI_CFG_COMPRESS
+    p_session->lz_is_on = 0;
+    p_session->lz_num_pending = 0;
+#endif
+
+    p_session->esc_state = eESC_GROUND;
+    p_session->esc_param_idx = 0;
+    memset(p_session->esc_params, 0, NUM_ESC_PARAMS);
 
-    memset(white_spaces, ' ', LEN_STD_STR + LEN_PROMPT);
-    white_spaces[LEN_STD_STR + LEN_PROMPT - 1] = 0;
+    p_cli = p_session;
+
+    if (!is_shared_init)
+    {
+        CliInitShared();
+    }
 
+    sessions[i] = p_session;
     CliSendString(prompt);
 
+    if (prev)
+    {
+        p_cli = prev;  // the first session stays the current one
+    }
+
     return 0;
 }
 
+int CliRemoveSession(tCli *p_session)
+{
+    for (unsigned i = 0; i < CLI_MAX_SESSIONS; ++i)
+    {
+        if (sessions[i] == p_session)
+        {
+            sessions[i] = NULL;
+
+            if (p_cli == p_session)
+            {
+                p_cli = p_uart;
+            }
+            if (p_uart == p_session)
+            {
+                p_uart = NULL;
+            }
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+int CliHandleSession(tCli *p_session)
+{
+    tCli *prev = p_cli;
+    int retval = 0;
+
+    p_cli = p_session;
+    retval = CliHandleInput();
+    p_cli = prev;
+
+    return retval;
+}
+
 void CliPeriodicCheck()
 {
-    if(p_cli->was_input_received)
+    for (unsigned i = 0; i < CLI_MAX_SESSIONS; ++i)
     {
-        CliHandleInput();
+        if (sessions[i] && sessions[i]->was_input_received)
+        {
+            CliHandleSession(sessions[i]);
+        }
     }
 }
 
@@ -102,512 +269,1377 @@ char* CliUtoa(unsigned long value, char *str, int base)
     {
         str[j] = temp_str[num_digits - j - 1];
     }
+    str[num_digits] = 0;
 
     return str;
 }
 
-int CliRxISR()    // ISR for each char received
+/* Echo never points into the line: it changes, and is run in place, before the Tx ISR gets to
+ * the text. Typed chars come from here, other line text is copied to the arena. */
+#define CLI_ECHO_ROW(c) c, 0, c + 1, 0, c + 2, 0, c + 3, 0, c + 4, 0, c + 5, 0, c + 6, 0, c + 7, 0, \
+    c + 8, 0, c + 9, 0, c + 10, 0, c + 11, 0, c + 12, 0, c + 13, 0, c + 14, 0, c + 15, 0
+static const char echo_chars[] =
 {
-    int retval = 0;
-    char rec_char = 0;
-    static char esc_number = 0;
-    static int last_in_buff_idx = NUM_IN_CMD_RECALL - 1;
-    static int history_buff_idx = 0;
-    static char stashed_buffer[LEN_STD_STR] = { 0 };
+    CLI_ECHO_ROW(32), CLI_ECHO_ROW(48), CLI_ECHO_ROW(64), CLI_ECHO_ROW(80), CLI_ECHO_ROW(96), CLI_ECHO_ROW(112)
+};
 
-    char str_buffer[4] = { 0 };  // up to 999
-    char temp = 0;
-
-    // debug
-    static char escape_buff[LEN_STD_STR] = { 0 };
-    static int eb_idx = 0;
+/* len bytes of text, then the cursor move "<move><num><final>" (none if final is 0), in one
+ * piece of the arena, so a move never goes out without its count. NULL if there's no room,
+ * the key is refused then, before anything changed */
+static char* CliEchoMove(const char *text, unsigned len, const char *move, unsigned num, char final)
+{
+    char digits[12] = { 0 };
+    unsigned len_move = strlen(move);
+    unsigned len_num = final ? strlen(CliUtoa(num, digits, 10)) : 0;
+    char *echo = CliAlloc(len + len_move + len_num + 2);
 
-    static enum
+    if (echo)
     {
-        eNO_ESC_SEQ, eESC_RECVD, eO_RECVD, eBRCKT_RECVD, eESC_NUM, eVT_SEQ
-    } esc_state = eNO_ESC_SEQ;
+        memcpy(echo, text, len);
+        memcpy(&echo[len], move, len_move);
+        memcpy(&echo[len + len_move], digits, len_num);
+        echo[len + len_move + len_num] = final;
+        echo[len + len_move + len_num + 1] = 0;
+    }
 
-    rec_char = *p_cli->rx_reg_addr;
+    return echo;
+}
+
+#if CLI_CFG_NAVIGATION
+static int CliCursorToIdx(int idx)
+{
+    char *echo = CliEchoMove("", 0, "\r\e[", LEN_PROMPT + idx, 'C');
 
-    switch (rec_char)
+    if (!echo)
     {
-        case '\n':
-        case '\r':
-            temp = p_cli->input_buffer[p_cli->in_buff_idx][0];
-            if (temp != 0 && temp != ' ' && temp != '\t')
-            {
-                p_cli->was_input_received = 1;
-                last_in_buff_idx = p_cli->in_buff_idx;
-                history_buff_idx = last_in_buff_idx + 1;
-                if (history_buff_idx > NUM_IN_CMD_RECALL - 1)
-                {
-                    history_buff_idx = 0;
-                }
-            }
-            else
-            {
-                p_cli->input_buffer[p_cli->in_buff_idx][0] = 0;
-                p_cli->idx = 0;
-                CliSendString("\r\n");
-                CliSendString(prompt);
-                //CliSendString("\r\n> ");
-            }
-            break;
-        case '\b':
-        case 127:
-            retval = CliInsertChar(p_cli->input_buffer[p_cli->in_buff_idx], p_cli->idx, '\b');
-            //int retval = CliInsertChar(p_cli->input_buffer[p_cli->in_buff_idx], p_cli->idx, 127);
+        return -1;
+    }
 
-            if (retval)
-            {
-                CliSendString("\a");
-            }
-            else
-            {
-                p_cli->idx--;  // we tested for idx=0 up above
-            }
-            break;
-        default:
-            if (p_cli->idx >= LEN_STD_STR - 1)
-            {
-                p_cli->input_buffer[p_cli->in_buff_idx][LEN_STD_STR - 1] = 0;
+    CliSendString(echo);
+    p_cli->idx = idx;
 
-                CliSendString("\a");
-                return 0;
-            }
-
-            switch (esc_state)
-            {
-                case eNO_ESC_SEQ:
-                    if (rec_char == 27) // ESC
-                    {
-#ifdef DEBUG
-				escape_buff[eb_idx++] = rec_char;
-#endif
-                        esc_state = eESC_RECVD;
-                    }
-                    else   // normal char
-                    {
-#ifdef DEBUG
-                        eb_idx = 0;
-#endif
-                        retval = CliInsertChar(p_cli->input_buffer[p_cli->in_buff_idx], p_cli->idx, rec_char);
-
-                        if (!retval)
-                        {
-                            p_cli->idx++;
-                        }
-                    }
-                    break;
-                case eESC_RECVD:
-#ifdef DEBUG
-			escape_buff[eb_idx++] = rec_char;
-#endif
-
-                    if (rec_char == '[')
-                    {
-                        esc_state = eBRCKT_RECVD;
-                    }
-                    else if (rec_char == 'O')	// minicom does END with ^[OF
-                    {
-                        esc_state = eO_RECVD;
-                    }
-                    else
-                    {
-                        esc_state = eNO_ESC_SEQ;
-                        eb_idx = 0;
-
-                        CliSendString("\a");
-                    }
-                    break;
-                case eO_RECVD:
-                case eBRCKT_RECVD:
-#ifdef DEBUG
-			escape_buff[eb_idx++] = rec_char;
-#endif
-
-                    if (rec_char > '0' && rec_char < '9')
-                    {
-                        esc_number = rec_char - '0';
-                        esc_state = eESC_NUM;
-                        break;
-                    }
-                    else if (rec_char == 'a' || rec_char == 'A') /* up */
-                    {
-                        // stash buffer if it is the current one
-                        // decrement in_buff_idx
-                        // load historic buffer into current one
-                        // clear CLI
-                        // print current buffer
-
-                        if (history_buff_idx == p_cli->in_buff_idx)
-                        {
-                            strcpy(stashed_buffer, p_cli->input_buffer[p_cli->in_buff_idx]);
-                        }
-
-                        --history_buff_idx;
-                        if (history_buff_idx < 0)
-                        {
-                            history_buff_idx = NUM_IN_CMD_RECALL - 1;
-                        }
-
-                        if (history_buff_idx == p_cli->in_buff_idx || p_cli->input_buffer[history_buff_idx][0] == 0)
-                        {
-                            ++history_buff_idx;
-                            if (history_buff_idx > NUM_IN_CMD_RECALL - 1)
-                            {
-                                history_buff_idx = 0;
-                            }
-                            CliSendString("\a");
-                        }
-
-                        CliClear();
-
-                        // copy buffer to curr_buff, update idx, restore in_buff_idx
-                        strcpy(p_cli->input_buffer[p_cli->in_buff_idx], p_cli->input_buffer[history_buff_idx]);
-                        p_cli->idx = strlen(p_cli->input_buffer[history_buff_idx]);
-
-                        CliSendString(p_cli->input_buffer[p_cli->in_buff_idx]);
-
-                    }
-                    else if (rec_char == 'b' || rec_char == 'B') /* down */
-                    {
-                        int prev_history_buff_idx = history_buff_idx;
-
-                        if (history_buff_idx != p_cli->in_buff_idx)
-                        {
-                            ++history_buff_idx;
-                            if (history_buff_idx > NUM_IN_CMD_RECALL - 1)
-                            {
-                                history_buff_idx = 0;
-                            }
-                        }
-                        else
-                        {
-                            CliSendString("\a"); // bonk
-                            //break;
-                        }
-
-                        CliClear();
-
-                        if (history_buff_idx == p_cli->in_buff_idx && prev_history_buff_idx != history_buff_idx)
-                        {
-                            // cannot go down any further, restore stashed buffer
-
-                            strcpy(p_cli->input_buffer[p_cli->in_buff_idx], stashed_buffer);
-                            stashed_buffer[0] = 0;
-                        }
-                        else
-                        {
-                            strcpy(p_cli->input_buffer[p_cli->in_buff_idx], p_cli->input_buffer[history_buff_idx]);
-                        }
-
-                        p_cli->idx = strlen(p_cli->input_buffer[p_cli->in_buff_idx]);
-                        CliSendString(p_cli->input_buffer[p_cli->in_buff_idx]);
-
-                    }
-                    else if (rec_char == 'c' || rec_char == 'C') /* right */
-                    {
-                        /*CliSendString("right");*/
-
-                        if (p_cli->idx < strlen(p_cli->input_buffer[p_cli->in_buff_idx]))
-                        {
-                            p_cli->idx++;
-                            CliSendString("\e[C");
-                        }
-                        else
-                        {
-                            CliSendString("\a");
-                        }
-                    }
-                    else if (rec_char == 'd' || rec_char == 'D') /* left */
-                    {
-                        /*CliSendString("left");*/
-
-                        if (p_cli->idx)
-                        {
-                            p_cli->idx--;
-                            CliSendString("\e[D");
-                        }
-                        else
-                        {
-                            CliSendString("\a");
-                        }
-                    }
-                    else if (rec_char == 'h' || rec_char == 'H') /* home */
-                    {
-                        p_cli->idx = 0;
-
-                        CliUtoa(LEN_PROMPT, str_buffer, 10);
-
-                        CliSendString("\r\e[");
-                        CliSendString(str_buffer);
-                        CliSendString("C");
-                    }
-                    else if (rec_char == 'f' || rec_char == 'F') /* end */
-                    {
-                        p_cli->idx = strlen(p_cli->input_buffer[p_cli->in_buff_idx]);
-
-                        CliUtoa(LEN_PROMPT + p_cli->idx, str_buffer, 10);
-
-                        CliSendString("\r\e[");
-                        CliSendString(str_buffer);
-                        CliSendString("C");
-                    }
-
-                    esc_state = eNO_ESC_SEQ;
-                    eb_idx = 0;
-
-                    break;
-                case eESC_NUM:
-#ifdef DEBUG
-			escape_buff[eb_idx++] = rec_char;
-#endif
-
-                    if (rec_char != '~')
-                    {
-                        esc_number = 0;
-                        esc_state = eNO_ESC_SEQ;
-                        eb_idx = 0;
-                        break;
-                    }
-                    esc_state = eVT_SEQ;	// no diff, fall through
-                case eVT_SEQ:
-                    switch (esc_number)
-                    {
-                        case 1:  // home (VT102)
-                            p_cli->idx = 0;
-
-                            CliUtoa(LEN_PROMPT, str_buffer, 10);
-
-                            CliSendString("\r\e[");
-                            CliSendString(str_buffer);
-                            CliSendString("C");
-
-                            break;
-                        case 3: // delete (not DEL)
-                            retval = CliInsertChar(p_cli->input_buffer[p_cli->in_buff_idx], p_cli->idx, 127);
-
-                            if (retval)
-                            {
-                                CliSendString("\a");
-                            }
-                            break;
-                        case 4:  // end (VT102)
-                            p_cli->idx = strlen(p_cli->input_buffer[p_cli->in_buff_idx]);
-
-                            CliUtoa(LEN_PROMPT + p_cli->idx, str_buffer, 10);
-
-                            CliSendString("\r\e[");
-                            CliSendString(str_buffer);
-                            CliSendString("C");
-
-                            break;
-                        default:
-                            break;
-                    }
-
-                    esc_number = 0;
-                    esc_state = eNO_ESC_SEQ;
-                    eb_idx = 0;
-
-                    break;
-                default:
-                    break;
-            }
+    return 0;
+}
 
-            break;
+/* Prompt and line (after clear, if any), the rest of the row blanked and the cursor at idx,
+ * which become the session's */
+static int CliRedraw(const char *clear, const char *line, int idx)
+{
+    unsigned len = strlen(line);
+    char *echo = CliEchoMove(line, len, "\e[K\r\e[", LEN_PROMPT + idx, 'C');
+
+    if (!echo)
+    {
+        return -1;
+    }
+
+    if (clear)
+    {
+        CliSendString(clear);
     }
+    CliSendString(prompt);
+    CliSendString(echo);
+
+    memmove(p_cli->line, line, len + 1);
+    p_cli->idx = idx;
 
     return 0;
 }
 
-int CliTxISR()    // ISR for each "ready to send char"
+static int CliWordLeft(const char *line, int idx)
 {
-    static unsigned char_idx = 0;
-    static unsigned buffer_idx = 0;
-    static char *buffer = 0;
-
-    if (buffer)
+    while (idx && (line[idx - 1] == ' ' || line[idx - 1] == '\t'))
     {
-        //if(p_cli->output_buffer[buffer_idx][char_idx])
-        if (buffer[char_idx])
-        {
-            //*p_cli->tx_reg_addr = p_cli->output_buffer[buffer_idx][char_idx];
-            *p_cli->tx_reg_addr = buffer[char_idx];
-            char_idx++;
-        }
-        else
-        {
-            buffer = 0;
-            char_idx = 0;
-        }
+        --idx;
     }
-    else
+    while (idx && line[idx - 1] != ' ' && line[idx - 1] != '\t')
     {
-        if (p_cli->output_buffer[buffer_idx] && buffer_idx < NUM_OUT_MSG_QUEUE) // fetch next buffer in queue
-        {
-            buffer = p_cli->output_buffer[buffer_idx];
-            buffer_idx++;
-        }
-        else
-        {
-            buffer = 0;
-            char_idx = 0;
-            buffer_idx = 0;
+        --idx;
+    }
 
-            memset(p_cli->output_buffer, 0, NUM_OUT_MSG_QUEUE*sizeof(char*));
+    return idx;
+}
 
-            p_cli->DisableUartInt();
-        }
+static int CliWordRight(const char *line, int idx)
+{
+    while (line[idx] == ' ' || line[idx] == '\t')
+    {
+        ++idx;
+    }
+    while (line[idx] && line[idx] != ' ' && line[idx] != '\t')
+    {
+        ++idx;
     }
 
-    return 0;
+    return idx;
 }
+#endif
 
-int CliInsertChar(char *str, int position, char character)
+#if CLI_CFG_HISTORY
+static void CliHistoryPush(const char *line)
 {
-    int len_str = strlen(str);
-    int len_rem = len_str - position;
-    char num_rem_chars_str[4] = { 0 };  // up to 999
+    unsigned len = strlen(line) + 1;
+    unsigned len_oldest = 0;
+    unsigned last = p_cli->history_len;
 
-    switch (character)
+    /* don't repeat the newest entry */
+    if (last)
     {
-        case '\b': // backspace (internal, not from UART)
-            if (position == 0)
-            {
-                return -1;
-            }
-
-            if (position < len_str)
-            {
-                memmove(&str[position - 1], &str[position], len_rem + 1); // copy also \0
-
-                CliSendString("\e[D");
-                CliSendString(&str[position - 1]);
-                CliSendString(" ");
-                //get back the amount of characters printed over:
-                // get back len-idx
+        for (--last; last && p_cli->history[last - 1]; --last);
+        if (!strcmp(&p_cli->history[last], line))
+        {
+            p_cli->history_pos = p_cli->history_len;
+            return;
+        }
+    }
 
-                CliUtoa(len_rem + 1, num_rem_chars_str, 10);
+    if (len > LEN_HISTORY)
+    {
+        return;
+    }
 
-                CliSendString("\e[");
-                CliSendString(num_rem_chars_str);
-                CliSendString("D");
-            }
-            else
-            {
-                str[position - 1] = 0;
-                CliSendString("\b \b");
-            }
+    /* make room by dropping the oldest entries */
+    while (p_cli->history_len + len > LEN_HISTORY)
+    {
+        len_oldest = strlen(p_cli->history) + 1;
+        p_cli->history_len -= len_oldest;
+        memmove(p_cli->history, &p_cli->history[len_oldest], p_cli->history_len);
+    }
 
-            break;
-        case 127:  // delete (internal, not from UART)
+    memcpy(&p_cli->history[p_cli->history_len], line, len);
+    p_cli->history_len += len;
+    p_cli->history_pos = p_cli->history_len;
+}
 
-            if (position < len_str)
-            {
-                memmove(&str[position], &str[position + 1], len_rem); // copy also \0
+static int CliHistoryShow(const char *entry)
+{
+    unsigned len = strlen(entry);  // entries came from line, they fit
+    char *echo = CliEchoMove(entry, len, "\e[K", 0, 0);
 
-                CliSendString(&str[position]);
-                CliSendString(" ");
-                //get back the amount of characters printed over:
-                // get back len-idx
+    if (!echo)
+    {
+        return -1;
+    }
 
-                CliUtoa(len_rem, num_rem_chars_str, 10);
+    CliSendString(prompt);
+    CliSendString(echo);
 
-                CliSendString("\e[");
-                CliSendString(num_rem_chars_str);
-                CliSendString("D");
-            }
-            else
-            {
-                return -1;
-            }
+    memcpy(p_cli->line, entry, len + 1);
+    p_cli->idx = len;
 
-            break;
-        default:
-            if (len_str + 1 >= LEN_STD_STR - 1)
-            {
-                return -1;
-            }
+    return 0;
+}
 
-            if (position < len_str)
-            {
-                memmove(&str[position + 1], &str[position], len_rem + 1); // copy also \0
-                str[position] = character;
+static void CliHistoryUp(void)
+{
+    unsigned pos = p_cli->history_pos;
 
-                CliSendString(&str[position]);
+    if (!pos)
+    {
+        CliSendString("\a");  // oldest one already
+        return;
+    }
 
-                // move cursor back the amount of characters printed over:
-                CliUtoa(len_rem, num_rem_chars_str, 10);
+    if (pos == p_cli->history_len)
+    {
+        strcpy(p_cli->stash, p_cli->line);
+    }
 
-                CliSendString("\e[");
-                CliSendString(num_rem_chars_str);
-                CliSendString("D");
-            }
-            else if (position == len_str)
-            {
-                str[position] = character;
-                str[position + 1] = 0;
+    /* back to the start of the previous entry */
+    for (--pos; pos && p_cli->history[pos - 1]; --pos);
 
-                CliSendString(&str[position]);
-            }
-            break;
+    if (CliHistoryShow(&p_cli->history[pos]))
+    {
+        CliSendString("\a");  // no room for the echo now
+        return;
     }
-
-    return 0;
+    p_cli->history_pos = pos;
 }
 
-int CliClear()
+static void CliHistoryDown(void)
 {
-    CliSendString("\r");
-    CliSendString(white_spaces);
-    CliSendString(prompt);
-}
+    unsigned pos = p_cli->history_pos;
 
-void CliSendString(const char *orig)
-{
-    for (unsigned i = 0; i < NUM_OUT_MSG_QUEUE; ++i)
+    if (pos == p_cli->history_len)
     {
-        if (!p_cli->output_buffer[i])
-        {
-            p_cli->output_buffer[i] = orig;
-            break;
-        }
+        CliSendString("\a"); // bonk
+        return;
     }
-    p_cli->EnableUartInt();
+
+    pos += strlen(&p_cli->history[pos]) + 1;
+
+    if (CliHistoryShow(pos == p_cli->history_len ? p_cli->stash : &p_cli->history[pos]))
+    {
+        CliSendString("\a");
+        return;
+    }
+    p_cli->history_pos = pos;
 }
+#endif
 
-int CliHandleInput()
+static void CliHandleKey(int key, char rec_char)
 {
-    static char temp_buffer[LEN_STD_STR] = { 0 };
+    char *line = p_cli->line;
+#if CLI_CFG_NAVIGATION
+    int len = strlen(line);
+    int idx = 0;
+    char killed[LEN_STD_STR];
+#endif
+    char temp = 0;
 
-    if (p_cli->input_buffer[p_cli->in_buff_idx][0])
+    if (p_cli->was_input_received)
     {
-        strcpy(temp_buffer, p_cli->input_buffer[p_cli->in_buff_idx]);
-
-        char *token = strtok(temp_buffer, " \t");
+        p_cli->rx_drops++;
+        return;  // line is being executed, drop the typeahead
+    }
 
-        for (unsigned i = 0; commands[i].handle[0]; ++i)
-        {
-            if (!strcmp(token, commands[i].handle))
+    switch (key)
+    {
+        case eKEY_INSERT:
+            if (CliInsertChar(line, p_cli->idx, rec_char))
             {
-                token = strtok(NULL, "");
-                if(commands[i].callback)
+                CliSendString("\a");
+            }
+            else
+            {
+                p_cli->idx++;
+            }
+            break;
+        case eKEY_ENTER:
+            temp = line[0];
+            if (temp != 0 && temp != ' ' && temp != '\t')
+            {
+#if CLI_CFG_LATENCY
+                p_cli->t_line = CliGetCycles() | 1;
+#endif
+                p_cli->was_input_received = 1;
+
+                if (p_cli->LineReady)
                 {
-                    CliSendString("\r\n");
-                    commands[i].callback(token);
+                    p_cli->LineReady();
                 }
             }
-        }
-
-        /* prepare a fresh input buffer */
-        if (++p_cli->in_buff_idx > NUM_IN_CMD_RECALL - 1)
-        {
-            p_cli->in_buff_idx = 0;
-        }
-
-        p_cli->input_buffer[p_cli->in_buff_idx][0] = 0;
+            else
+            {
+                line[0] = 0;
+                p_cli->idx = 0;
+                CliSendString("\r\n");
+                CliSendString(prompt);
+            }
+            break;
+#if CLI_CFG_COMPLETION
+        case eKEY_TAB:
+            CliComplete();
+            break;
+#endif
+        case eKEY_BACKSPACE:
+            if (CliInsertChar(line, p_cli->idx, '\b'))
+            {
+                CliSendString("\a");
+            }
+            else
+            {
+                p_cli->idx--;  // CliInsertChar tested for idx=0
+            }
+            break;
+#if CLI_CFG_HISTORY
+        case eKEY_UP:
+            CliHistoryUp();
+            break;
+        case eKEY_DOWN:
+            CliHistoryDown();
+            break;
+#endif
+#if CLI_CFG_NAVIGATION
+        case eKEY_DELETE:
+            if (CliInsertChar(line, p_cli->idx, 127))
+            {
+                CliSendString("\a");
+            }
+            break;
+        case eKEY_RIGHT:
+            if (p_cli->idx < len)
+            {
+                p_cli->idx++;
+                CliSendString("\e[C");
+            }
+            else
+            {
+                CliSendString("\a");
+            }
+            break;
+        case eKEY_LEFT:
+            if (p_cli->idx)
+            {
+                p_cli->idx--;
+                CliSendString("\e[D");
+            }
+            else
+            {
+                CliSendString("\a");
+            }
+            break;
+        case eKEY_HOME:
+        case eKEY_END:
+        case eKEY_WORD_LEFT:
+        case eKEY_WORD_RIGHT:
+            idx = key == eKEY_HOME ? 0 : key == eKEY_END ? len
+                : key == eKEY_WORD_LEFT ? CliWordLeft(line, p_cli->idx) : CliWordRight(line, p_cli->idx);
+            if (CliCursorToIdx(idx))
+            {
+                CliSendString("\a");  // no room for the move now, the cursor stays
+            }
+            break;
+        case eKEY_KILL_EOL:
+            line[p_cli->idx] = 0;
+            CliSendString("\e[K");
+            break;
+        case eKEY_KILL_BOL:
+            if (CliRedraw(NULL, &line[p_cli->idx], 0))
+            {
+                CliSendString("\a");
+            }
+            break;
+        case eKEY_KILL_WORD:
+            idx = CliWordLeft(line, p_cli->idx);
+            memcpy(killed, line, idx);
+            strcpy(&killed[idx], &line[p_cli->idx]);
+            if (CliRedraw(NULL, killed, idx))
+            {
+                CliSendString("\a");
+            }
+            break;
+        case eKEY_REDRAW:
+            if (CliRedraw("\e[2J\e[H", line, p_cli->idx))
+            {
+                CliSendString("\a");
+            }
+            break;
+#endif
+        case eKEY_ABORT:
+            line[0] = 0;
+            p_cli->idx = 0;
+            CliSendString("^C\r\n");
+            CliSendString(prompt);
+            break;
+        default:
+            break;  // unknown keys and sequences are dropped quietly
+    }
+}
+
+int CliRxISR()    // ISR for each char received
+{
+    return CliRxChar(p_uart, *p_uart->rx_reg_addr);
+}
+
+int CliEscKey(unsigned char rec_char)
+{
+    unsigned char *params = p_cli->esc_params;
+    unsigned char entry = 0;
+    unsigned param = 0;
+    int key = eKEY_NONE;
+
+    if (p_cli->esc_state == eESC_GROUND)
+    {
+        if (rec_char >= ' ' && rec_char < 127)
+        {
+            return eKEY_INSERT;  // typed text, what the table gives for it too
+        }
+        if (rec_char == 0x1B)
+        {
+            p_cli->esc_state = eESC_ESC;  // and the start of every sequence
+            return eKEY_NONE;
+        }
+        if (rec_char < ' ')
+        {
+            return esc_ctrl_keys[rec_char];  // control keys, Backspace (^H) among them
+        }
+    }
+
+    /* one lookup for the class, one for the transition, see tools/gen_esc_table.py */
+    entry = esc_transitions[p_cli->esc_state][rec_char < 128 ? esc_classes[rec_char] : eCL_OTHER];
+    p_cli->esc_state = ESC_NEXT(entry);
+
+    switch (ESC_ACTION(entry))
+    {
+        case eACT_INSERT:
+            key = eKEY_INSERT;
+            break;
+        case eACT_CTRL:
+            key = rec_char == 127 ? eKEY_BACKSPACE : esc_ctrl_keys[rec_char & 0x1F];
+            break;
+        case eACT_ALT:
+            key = rec_char < 128 ? esc_alt_keys[rec_char] : eKEY_NONE;
+            break;
+        case eACT_CLEAR:
+            p_cli->esc_param_idx = 0;
+            params[0] = 0;
+            params[1] = 0;
+            break;
+        case eACT_PARAM:
+            if (p_cli->esc_param_idx < NUM_ESC_PARAMS)
+            {
+                param = params[p_cli->esc_param_idx] * 10 + rec_char - '0';
+                params[p_cli->esc_param_idx] = param > 255 ? 255 : param;
+            }
+            break;
+        case eACT_NEXT_PARAM:
+            if (p_cli->esc_param_idx < NUM_ESC_PARAMS)
+            {
+                p_cli->esc_param_idx++;
+            }
+            break;
+        case eACT_CSI:
+        case eACT_SS3:
+            key = esc_final_keys[rec_char - ESC_FIRST_FINAL];
+
+            /* xterm modifiers, ESC [ 1 ; 5 C or ESC O 5 C: 1 + (shift 1 | alt 2 | ctrl 4) */
+            param = params[ESC_ACTION(entry) == eACT_CSI ? 1 : 0];
+            if (param > 2 && key == eKEY_RIGHT)
+            {
+                key = eKEY_WORD_RIGHT;
+            }
+            else if (param > 2 && key == eKEY_LEFT)
+            {
+                key = eKEY_WORD_LEFT;
+            }
+            break;
+        case eACT_TILDE:
+            key = params[0] < sizeof(esc_tilde_keys) ? esc_tilde_keys[params[0]] : eKEY_NONE;
+            break;
+        default:
+            break;
+    }
+
+    return key;
+}
+
+static void CliRxKey(unsigned char rec_char)
+{
+    int key = CliEscKey(rec_char);
+
+    if (key != eKEY_NONE)
+    {
+        CliHandleKey(key, rec_char);
+    }
+}
+
+#if CLI_CFG_LATENCY
+static void CliByteCycles(unsigned long *max, unsigned long t_start)
+{
+    unsigned long cycles = CliGetCycles() - t_start;
+
+    if (cycles > *max)
+    {
+        *max = cycles;
+    }
+    if (cycles > CLI_ISR_BUDGET && p_cli->over_budget < 0xFFFF)
+    {
+        p_cli->over_budget++;
+    }
+}
+#endif
+
+int CliRxChar(tCli *p_session, char rec_char)
+{
+    tCli *prev = p_cli;
+#if CLI_CFG_LATENCY
+    unsigned long t_start = CliGetCycles();
+#endif
+
+    p_cli = p_session;  // everything below works on this session
+
+#if CLI_CFG_XFER
+    if (CliXferIsActive())
+    {
+        CliXferRxByte(rec_char);  // binary block, no line editing
+    }
+    else
+#endif
+    {
+#if CLI_CFG_CAPTURE
+        CliCaptureByte(rec_char, 0);
+#endif
+        CliRxKey(rec_char);
+    }
+
+#if CLI_CFG_LATENCY
+    CliByteCycles(&p_cli->rx_byte_max, t_start);
+#endif
+    p_cli = prev;
+
+    return 0;
+}
+
+int CliTxISR()    // ISR for each "ready to send char"
+{
+    char c = 0;
+
+    if (CliTxChar(p_uart, &c))
+    {
+        *p_uart->tx_reg_addr = (unsigned char)c;
+    }
+
+    return 0;
+}
+
+int CliTxChar(tCli *p_session, char *c)
+{
+    tCli *prev = p_cli;
+    const char *text = NULL;
+    int retval = 0;
+#if CLI_CFG_LATENCY
+    unsigned long t_start = CliGetCycles();
+#endif
+
+    p_cli = p_session;
+
+#if CLI_CFG_XFER
+    if (CliXferIsActive())
+    {
+        /* text waits until the transfer is done */
+        retval = CliXferTxByte(c);
+        if (!retval)
+        {
+            p_cli->DisableUartInt();
+        }
+
+#if CLI_CFG_LATENCY
+        CliByteCycles(&p_cli->tx_byte_max, t_start);
+#endif
+        p_cli = prev;
+        return retval;
+    }
+#endif
+
+    text = CliTxText();
+
+#if CLI_CFG_COMPRESS
+    if (p_cli->lz_is_on || p_cli->lz_num_pending)
+    {
+        retval = CliLzTxByte(text, c);
+    }
+    else
+#endif
+    if (text)
+    {
+        *c = *text;
+        p_cli->tx_char_idx++;
+        retval = 1;
+    }
+
+    if (retval)
+    {
+#if CLI_CFG_CAPTURE
+        CliCaptureByte(*c, 1);
+#endif
+    }
+    else
+    {
+        if (!p_cli->was_input_received)
+        {
+            p_cli->arena_used = 0;  // everything allocated was sent, and no callback holds any of it
+        }
+
+        p_cli->DisableUartInt();
+
+        if (p_cli->TxIdle)
+        {
+            p_cli->TxIdle();
+        }
+    }
+
+#if CLI_CFG_LATENCY
+    CliByteCycles(&p_cli->tx_byte_max, t_start);
+#endif
+    p_cli = prev;
+
+    return retval;
+}
+
+const char* CliTxText(void)
+{
+    for (;;)
+    {
+        if (p_cli->tx_buffer)
+        {
+            if (p_cli->tx_buffer[p_cli->tx_char_idx])
+            {
+                return &p_cli->tx_buffer[p_cli->tx_char_idx];
+            }
+
+            p_cli->tx_buffer = NULL;
+            p_cli->tx_char_idx = 0;
+        }
+
+        if (p_cli->out_tail == p_cli->out_head)
+        {
+            return NULL;
+        }
+
+        // fetch next buffer in queue, which frees its slot
+        p_cli->tx_buffer = p_cli->output_buffer[p_cli->out_tail];
+        p_cli->out_tail = (p_cli->out_tail + 1) % NUM_OUT_MSG_QUEUE;
+    }
+}
+
+int CliInsertChar(char *str, int position, char character)
+{
+    int len_str = strlen(str);
+    int len_rem = len_str - position;
+    char *echo = NULL;
+
+    switch (character)
+    {
+        case '\b': // backspace (internal, not from UART)
+            if (position == 0)
+            {
+                return -1;
+            }
+
+            if (position < len_str)
+            {
+                /* left, the rest of the line and a blank over its last char, back over both */
+                if (!(echo = CliEchoMove(&str[position], len_rem, " \e[", len_rem + 1, 'D')))
+                {
+                    return -1;  // no room for the echo, refused like a full line
+                }
+
+                memmove(&str[position - 1], &str[position], len_rem + 1); // copy also \0
+
+                CliSendString("\e[D");
+                CliSendString(echo);
+            }
+            else
+            {
+                str[position - 1] = 0;
+                CliSendString("\b \b");
+            }
+
+            break;
+        case 127:  // delete (internal, not from UART)
+
+            if (position < len_str)
+            {
+                if (!(echo = CliEchoMove(&str[position + 1], len_rem - 1, " \e[", len_rem, 'D')))
+                {
+                    return -1;
+                }
+
+                memmove(&str[position], &str[position + 1], len_rem); // copy also \0
+
+                CliSendString(echo);
+            }
+            else
+            {
+                return -1;
+            }
+
+            break;
+        default:
+            if (len_str + 1 >= LEN_STD_STR - 1)
+            {
+                return -1;
+            }
+
+            if (position < len_str)
+            {
+                memmove(&str[position + 1], &str[position], len_rem + 1); // copy also \0
+                str[position] = character;
+
+                /* the new char and the rest, then back over the rest */
+                if (!(echo = CliEchoMove(&str[position], len_rem + 1, "\e[", len_rem, 'D')))
+                {
+                    memmove(&str[position], &str[position + 1], len_rem + 1);
+                    return -1;
+                }
+
+                CliSendString(echo);
+            }
+            else if (position == len_str)
+            {
+                if ((unsigned char)character >= ' ' && (unsigned char)character < 127)
+                {
+                    CliSendString(&echo_chars[(character - ' ') * 2]);
+                }
+                else if ((echo = CliEchoMove(&character, 1, "", 0, 0)))
+                {
+                    CliSendString(echo);
+                }
+                else
+                {
+                    return -1;
+                }
+
+                str[position] = character;
+                str[position + 1] = 0;
+            }
+            break;
+    }
+
+    return 0;
+}
+
+#if CLI_CFG_COMPLETION
+void CliComplete(void)
+{
+    char *line = p_cli->line;
+    const tCmd *table = commands;
+#if CLI_CFG_GROUPS
+    const tCmd *cmd = NULL;
+    int is_sorted = are_commands_sorted;
+#endif
+    const char *match = NULL;
+    unsigned num = num_commands;
+    int num_matches = 0;
+    unsigned len_common = 0;
+    unsigned len = 0;
+    char *token = line;
+    char *word = line;
+    char *echo = NULL;
+
+    if ((size_t)p_cli->idx != strlen(line))
+    {
+        CliSendString("\a");  // only complete at the end of the line
+        return;
+    }
+
+    /* start of the current command in a sequence */
+    for (char *c = line; *c; ++c)
+    {
+        if (*c == ';' || *c == '&')
+        {
+            token = c + 1;
+        }
+    }
+
+    /* word being completed */
+    for (word = line + p_cli->idx; word > token && word[-1] != ' ' && word[-1] != '\t'; --word);
+
+    /* walk the groups typed so far */
+    for (;;)
+    {
+        token += strspn(token, " \t");
+        if (token >= word)
+        {
+            break;
+        }
+
+        len = strcspn(token, " \t");
+#if CLI_CFG_GROUPS
+        cmd = CliFindCmd(table, num, is_sorted, token, len);
+        if (cmd && cmd->children)
+        {
+            table = cmd->children;
+            num = cmd->num_children;
+            is_sorted = 1;
+            token += len;
+            continue;
+        }
+#endif
+        CliSendString("\a");  // arguments are not completed
+        return;
+    }
+
+    len = line + p_cli->idx - word;
+
+    for (unsigned i = 0; i < num; ++i)
+    {
+        if (strncmp(table[i].handle, word, len))
+        {
+            continue;
+        }
+
+        if (!num_matches++)
+        {
+            match = table[i].handle;
+            len_common = strlen(match);
+        }
+        else
+        {
+            unsigned j = len;
+            while (j < len_common && match[j] == table[i].handle[j])
+            {
+                ++j;
+            }
+            len_common = j;
+        }
+    }
+
+    if (!num_matches)
+    {
+        CliSendString("\a");
+        return;
+    }
+
+    if (len_common == len && num_matches > 1)
+    {
+        /* nothing more in common, show the candidates, the line again below them. That's more
+         * strings than the queue holds, so from the Rx ISR it's handed on like a line */
+        if (CliIsInIsr())
+        {
+            p_cli->is_listing = 1;
+            p_cli->was_input_received = 1;
+
+            if (p_cli->LineReady)
+            {
+                p_cli->LineReady();
+            }
+            return;
+        }
+
+        if (!(echo = CliEchoMove(line, p_cli->idx, "", 0, 0)))
+        {
+            CliSendString("\a");
+            return;
+        }
+
+        CliSendString("\r\n");
+        for (unsigned i = 0; i < num; ++i)
+        {
+            if (!strncmp(table[i].handle, word, len))
+            {
+                CliSendString(table[i].handle);
+                CliSendString("  ");
+            }
+        }
+        CliSendString("\r\n");
+        CliSendString(prompt);
+        CliSendString(echo);
+        return;
+    }
+
+    for (unsigned i = len; i < len_common; ++i)
+    {
+        if (!CliInsertChar(line, p_cli->idx, match[i]))
+        {
+            p_cli->idx++;
+        }
+    }
+
+    if (num_matches == 1 && !CliInsertChar(line, p_cli->idx, ' '))
+    {
+        p_cli->idx++;
+    }
+}
+#endif
+
+int CliClear()
+{
+    CliSendString("\r\e[K");
+    CliSendString(prompt);
+
+    return 0;
+}
+
+void CliSendString(const char *orig)
+{
+    unsigned state = 0;
+    unsigned char next = 0;
+
+    if (!orig)
+    {
+        return;  // e.g. CliAlloc ran out
+    }
+
+    for (;;)
+    {
+        state = CliEnterCritical();  // the Rx ISR echoes through here too
+
+        next = (p_cli->out_head + 1) % NUM_OUT_MSG_QUEUE;
+        if (next != p_cli->out_tail)
+        {
+            p_cli->output_buffer[p_cli->out_head] = orig;
+            p_cli->out_head = next;
+            CliExitCritical(state);
+            break;
+        }
+
+        CliExitCritical(state);
+
+        /* full: callbacks wait for the Tx ISR to free a slot, ISRs drop the string */
+#if CLI_CFG_XFER
+        if (CliIsInIsr() || CliXferIsActive())
+#else
+        if (CliIsInIsr())
+#endif
+        {
+            p_cli->tx_drops++;
+            break;
+        }
+    }
+
+    p_cli->EnableUartInt();
+}
+
+int CliFlush(void)
+{
+#if CLI_CFG_XFER
+    if (CliIsInIsr() || CliXferIsActive())
+#else
+    if (CliIsInIsr())
+#endif
+    {
+        return -1;
+    }
+
+#if CLI_CFG_COMPRESS
+    while (p_cli->out_tail != p_cli->out_head || p_cli->tx_buffer || p_cli->lz_num_pending)
+#else
+    while (p_cli->out_tail != p_cli->out_head || p_cli->tx_buffer)
+#endif
+    {
+        // the Tx ISR drains it, a token's second byte included
+    }
+
+    p_cli->arena_used = 0;
+
+    return 0;
+}
+
+static char* CliArenaTake(unsigned len)
+{
+    char *mem = NULL;
+    unsigned state = CliEnterCritical();  // the Rx ISR allocates for its echo too
+
+    if (len <= LEN_ARENA - (unsigned)p_cli->arena_used)
+    {
+        mem = &p_cli->arena[p_cli->arena_used];
+        p_cli->arena_used += len;
+
+        if (p_cli->arena_used > p_cli->arena_hwm)
+        {
+            p_cli->arena_hwm = p_cli->arena_used;
+        }
+    }
+
+    CliExitCritical(state);
+
+    return mem;
+}
+
+char* CliAlloc(unsigned len)
+{
+    char *mem = CliArenaTake(len);
+
+    if (!mem && len <= LEN_ARENA && !CliFlush())
+    {
+        mem = CliArenaTake(len);  // long output from a callback, the arena starts over once it's sent
+    }
+
+    return mem;
+}
+
+char* CliAllocNum(unsigned long value, int base)
+{
+    char digits[34] = { 0 };
+    char *str = NULL;
+    unsigned len = strlen(CliUtoa(value, digits, base)) + 1;
+
+    if ((str = CliAlloc(len)))
+    {
+        memcpy(str, digits, len);
+    }
+
+    return str;
+}
+
+int CliArenaCmd(char *args)
+{
+    CliSendString("arena: ");
+    CliSendString(CliAllocNum(p_cli->arena_used, 10));
+    CliSendString(" B used, ");
+    CliSendString(CliAllocNum(p_cli->arena_hwm, 10));
+    CliSendString(" B max of ");
+    CliSendString(CliAllocNum(LEN_ARENA, 10));
+
+    if (args && !strcmp(args, "-r"))
+    {
+        p_cli->arena_hwm = 0;
+    }
+
+    return 0;
+}
+
+static char* CliTrim(char *str)
+{
+    char *end = NULL;
+
+    while (*str == ' ' || *str == '\t')
+    {
+        ++str;
+    }
+
+    end = str + strlen(str);
+    while (end > str && (end[-1] == ' ' || end[-1] == '\t'))
+    {
+        *--end = 0;
+    }
+
+    return str;
+}
+
+const tCmd* CliFindCmd(const tCmd *table, unsigned num, int is_sorted, const char *handle, unsigned len)
+{
+    int cmp = 0;
+    unsigned lo = 0;
+    unsigned hi = num;
+
+    if (!is_sorted)
+    {
+        for (unsigned i = 0; i < num; ++i)
+        {
+            if (!strncmp(table[i].handle, handle, len) && !table[i].handle[len])
+            {
+                return &table[i];
+            }
+        }
+
+        return NULL;
+    }
+
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+
+        cmp = strncmp(table[mid].handle, handle, len);
+        if (!cmp)
+        {
+            cmp = table[mid].handle[len] ? 1 : 0;  // longer handle sorts after the token
+        }
+
+        if (!cmp)
+        {
+            return &table[mid];
+        }
+        else if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return NULL;
+}
+
+const tCmd* CliLookup(char **line)
+{
+    const tCmd *table = commands;
+    unsigned num = num_commands;
+    int is_sorted = are_commands_sorted;
+    const tCmd *found = NULL;
+    const tCmd *cmd = NULL;
+    char *token = *line;
+    unsigned len = 0;
+
+    for (;;)
+    {
+        token += strspn(token, " \t");
+        len = strcspn(token, " \t");
+
+        if (!len || !(cmd = CliFindCmd(table, num, is_sorted, token, len)))
+        {
+            break;
+        }
+
+        found = cmd;
+        token += len;
+
+#if CLI_CFG_GROUPS
+        if (!cmd->children)
+        {
+            break;
+        }
+
+        /* one search per level */
+        table = cmd->children;
+        num = cmd->num_children;
+        is_sorted = 1;
+#else
+        break;
+#endif
+    }
+
+    if (found)
+    {
+        *line = token + strspn(token, " \t");
+    }
+
+    return found;
+}
+
+void CliListCmds(const tCmd *table)
+{
+    for (unsigned i = 0; table[i].handle[0]; ++i)
+    {
+        CliSendString(table[i].handle);
+#if CLI_CFG_GROUPS
+        CliSendString(table[i].children ? " ... - " : " - ");
+#else
+        CliSendString(" - ");
+#endif
+
+        if (table[i].description)
+        {
+            CliSendString(table[i].description);
+        }
+
+        CliSendString("\r\n");
+    }
+}
+
+static int CliDispatch(char *cmd_line)
+{
+    char *args = cmd_line;
+    const tCmd *cmd = CliLookup(&args);
+
+    if (!cmd)
+    {
+#if CLI_CFG_MACROS
+        /* not a command, maybe a macro */
+        cmd_line[strcspn(cmd_line, " \t")] = 0;
+        return CliRunMacro(cmd_line);
+#else
+        return -1;
+#endif
+    }
+
+    if (cmd->callback)
+    {
+#if CLI_CFG_LATENCY
+        if (p_cli->t_line)
+        {
+            p_cli->last_latency = CliGetCycles() - (p_cli->t_line & ~1UL);
+            if (p_cli->last_latency > p_cli->max_latency)
+            {
+                p_cli->max_latency = p_cli->last_latency;
+            }
+            p_cli->t_line = 0;
+        }
+#endif
+
+        CliSendString("\r\n");
+        return cmd->callback(args);
+    }
+
+#if CLI_CFG_GROUPS
+    if (cmd->children)
+    {
+        CliSendString("\r\n");
+
+        if (*args)
+        {
+            CliSendString("unknown: ");
+            CliSendString(args);
+            return -1;
+        }
+
+        CliListCmds(cmd->children);
+    }
+#endif
+
+    return 0;
+}
+
+int CliExecute(char *line)
+{
+    int retval = 0;
+    char skip = 0;
+    char sep = 0;
+    char in_quotes = 0;
+    char *cmd = line;
+
+    for (char *c = line;; ++c)
+    {
+        sep = *c;
+
+        if (sep == '"')
+        {
+            in_quotes = !in_quotes;  // separators are plain chars inside quotes
+        }
+
+        if ((in_quotes && sep) || (sep != ';' && sep != 0 && !(sep == '&' && c[1] == '&')))
+        {
+            continue;
+        }
+
+        *c = 0;
+        cmd = CliTrim(cmd);
+
+        if (*cmd && !skip)
+        {
+            retval = CliDispatch(cmd);
+        }
+
+        if (sep == 0)
+        {
+            break;
+        }
+
+        if (sep == '&')
+        {
+            ++c;
+            skip = (retval != 0);  // skipping keeps retval, so the whole "&&" chain stops
+        }
+        else
+        {
+            skip = 0;
+        }
+
+        cmd = c + 1;
+    }
+
+    return retval;
+}
+
+#if CLI_CFG_MACROS
+const char* CliFindMacro(const char *name)
+{
+    const char *entry = macro_pool;
+
+    while (*entry)
+    {
+        const char *body = entry + strlen(entry) + 1;
+
+        if (!strcmp(entry, name))
+        {
+            return body;
+        }
+
+        entry = body + strlen(body) + 1;
+    }
+
+    return NULL;
+}
+
+int CliDefineMacro(const char *name, const char *body)
+{
+    char *entry = NULL;
+    char *end = NULL;
+    char *old = NULL;
+    unsigned old_len = 0;
+    unsigned len_name = strlen(name);
+    unsigned len_body = strlen(body);
+
+    if (!len_name || len_body > LEN_STD_STR - 1 || strpbrk(name, " \t;&"))
+    {
+        return -1;
+    }
+
+    /* find the end of the list and the old definition, if any */
+    for (end = macro_pool; *end; )
+    {
+        char *next = end + strlen(end) + 1;
+        next += strlen(next) + 1;
+
+        if (!strcmp(end, name))
+        {
+            old = end;
+            old_len = next - end;
+        }
+
+        end = next;
+    }
+
+    /* check for room first, a failed redefinition keeps the old one */
+    if (len_body && end - old_len + len_name + len_body + 3 > macro_pool + CLI_MACRO_POOL_SIZE)
+    {
+        return -1;
+    }
+
+    if (old)
+    {
+        memmove(old, old + old_len, end - (old + old_len) + 1);  // copy also the list terminator
+        end -= old_len;
+    }
+
+    if (len_body)
+    {
+        entry = end;
+        strcpy(entry, name);
+        entry += len_name + 1;
+        strcpy(entry, body);
+        entry[len_body + 1] = 0;
+    }
+
+    if (p_cli->StoreMacros)
+    {
+        p_cli->StoreMacros(macro_pool, CLI_MACRO_POOL_SIZE);
+    }
+
+    return 0;
+}
+
+int CliRunMacro(const char *name)
+{
+    static char macro_buffer[LEN_STD_STR] = { 0 };
+    static char is_running = 0;
+    const char *body = CliFindMacro(name);
+    int retval = 0;
+
+    if (!body)
+    {
+        return -1;
+    }
+
+    if (is_running)
+    {
+        CliSendString("\r\nmacros can't call macros");
+        return -1;
+    }
+
+    strcpy(macro_buffer, body);  // bodies are shorter than LEN_STD_STR, see CliDefineMacro()
+
+    is_running = 1;
+    retval = CliExecute(macro_buffer);
+    is_running = 0;
+
+    return retval;
+}
+
+void CliListMacros(void)
+{
+    const char *entry = macro_pool;
+
+    while (*entry)
+    {
+        const char *body = entry + strlen(entry) + 1;
+
+        CliSendString(entry);
+        CliSendString(" = ");
+        CliSendString(body);
+        CliSendString("\r\n");
+
+        entry = body + strlen(body) + 1;
+    }
+}
+#endif
+
+int CliHandleInput()
+{
+#if CLI_CFG_COMPLETION
+    if (p_cli->is_listing)
+    {
+        CliComplete();  // the line is as Tab left it, keys were dropped meanwhile
+        p_cli->is_listing = 0;
+        p_cli->was_input_received = 0;
+
+        return 0;
+    }
+#endif
+
+    if (p_cli->line[0])
+    {
+#if CLI_CFG_HISTORY
+        CliHistoryPush(p_cli->line);
+#endif
+
+        /* the whole sequence runs in place before the prompt comes back, keys are dropped meanwhile */
+        CliExecute(p_cli->line);
+        p_cli->line[0] = 0;
     }
 
     /* prepare the CLI */
@@ -615,8 +1647,10 @@ int CliHandleInput()
     CliSendString(prompt);
 
     p_cli->idx = 0;
+#if CLI_CFG_LATENCY
+    p_cli->t_line = 0;
+#endif
     p_cli->was_input_received = 0;
 
     return 0;
 }
-
@@ -34,53 +34,194 @@
  *     Provide callbacks for each one (or leave NULL for no action);
  *     Instantiate and initialize tCli in main.c;
  *     Register Rx and Tx ISRs for the UART on the Vector Table, or Call them where appropriate;
+ *     With load/save or capture enabled, call CliTick every ms (e.g. from SysTick_Handler): it is
+ *     their clock for timeouts, throughput and timestamps, which stand still without it;
+ *
+ * More sessions (e.g. a second UART, USB CDC, a socket on a Linux build, see cli_host.c) each get
+ * a tCli of their own, with their hooks set, passed to CliAddSession. They share the commands,
+ * macros and variables. Feed them with CliRxChar/CliTxChar from the same interrupt priority, or
+ * from the same thread.
  */
 
-#define DEBUG
-//#define SUPPORT_CLI_NAVIGATION /* turns off arrows, backspace, delete, home, and end. */
-#define NUM_OUT_MSG_QUEUE 50 /* Num of messages that can be queued in CliSendString(). Depends also on the number of commands you have. */
-#define NUM_IN_CMD_RECALL 10 /* how many commands should we recall */
-#define LEN_STD_STR 30
+/* Buffer sizes and optional features are chosen in cli_cfg.h */
+
+#define NUM_ESC_PARAMS 2       // CSI parameters kept, e.g. ESC [ 1 ; 5 C (eACT_CLEAR clears both)
 
-extern char white_spaces[];
 extern const char prompt[];
 
 typedef struct
 {
     unsigned *rx_reg_addr;
     unsigned *tx_reg_addr;
-    void (*DisableUartInt)(void);
+    void *transport;    /* for the hooks of sessions added with CliAddSession, e.g. a file descriptor */
+    void (*DisableUartInt)(void);   /* hooks are called with p_cli pointing to the session */
     void (*EnableUartInt)(void);
+#if CLI_CFG_MACROS
+    int (*StoreMacros)(const char *pool, unsigned len); /* called after each macro change */
+    int (*LoadMacros)(char *pool, unsigned len);        /* called once in CliInit */
+#endif
+    void (*LineReady)(void); /* from the Rx ISR when a line is complete, e.g. post to a queue, then call CliHandleInput */
+    void (*TxIdle)(void);    /* from the Tx ISR when everything queued was sent */
     volatile char was_input_received;
+#if CLI_CFG_COMPLETION
+    char is_listing;                /* Tab found several candidates, CliHandleInput lists them */
+#endif
+#if CLI_CFG_LATENCY
+    volatile unsigned long t_line;  /* CliGetCycles() at CR, 0 once the first callback was entered */
+    unsigned long last_latency;     /* cycles from CR to callback entry */
+    unsigned long max_latency;
+    unsigned long rx_byte_max;      /* cycles CliRxChar took for one byte */
+    unsigned long tx_byte_max;      /* and CliTxChar */
+    unsigned short over_budget;     /* bytes either took more than CLI_ISR_BUDGET for */
+#endif
+    unsigned short rx_drops;        /* keys typed while a line was executing */
+    unsigned short tx_drops;        /* strings an ISR found no room for */
     int idx;
-    int in_buff_idx;
-    int len_in_buffer[NUM_IN_CMD_RECALL];   // still to be implemented
-    /*char *input_buffer;*/
-    char input_buffer[NUM_IN_CMD_RECALL][LEN_STD_STR];
-    char *output_buffer[NUM_OUT_MSG_QUEUE];
+    char line[LEN_STD_STR];         /* being edited, executed in place by CliHandleInput */
+#if CLI_CFG_HISTORY
+    unsigned short history_len;     /* bytes used in history */
+    unsigned short history_pos;     /* entry on display, history_len for the live line */
+    char history[LEN_HISTORY];      /* "oldest\0...\0newest\0" */
+    char stash[LEN_STD_STR];        /* live line while browsing the history */
+#endif
+    volatile unsigned char out_head;    /* output_buffer is a ring, written by CliSendString */
+    volatile unsigned char out_tail;    /* and read by the Tx ISR */
+    const char *output_buffer[NUM_OUT_MSG_QUEUE];
+    const char *volatile tx_buffer;     /* string being sent */
+    unsigned tx_char_idx;
+    unsigned char esc_state;            /* key decoder, see tools/gen_esc_table.py */
+    unsigned char esc_param_idx;
+    unsigned char esc_params[NUM_ESC_PARAMS];
+    unsigned short arena_used;          /* bump allocator, see CliAlloc */
+    unsigned short arena_hwm;
+    char arena[LEN_ARENA];
+#if CLI_CFG_COMPRESS
+    unsigned char lz_is_on;             /* output is LZ coded, see cli_lz.c */
+    volatile unsigned char lz_num_pending; /* token bytes left to send, the last ones of lz_pending */
+    unsigned char lz_pending[2];
+    unsigned short lz_win_pos;          /* next write in lz_window */
+    unsigned short lz_win_len;
+    unsigned long lz_bytes_in;          /* text coded since "compress on" */
+    unsigned long lz_bytes_out;
+    unsigned char lz_window[LEN_LZ_WINDOW]; /* text sent last, what matches refer to */
+#endif
 } tCli; /* up to the user to instantiate*/
 
-typedef struct
+extern tCli *p_cli; /* session being served, the one passed to CliInit otherwise */
+
+typedef struct sCmd
 {
-    char *handle;
-    char *description;
+    const char *handle;
+    const char *description;
     int (*callback)(char*);
+#if CLI_CFG_GROUPS
+    const struct sCmd *children; /* command group, see CLI_GROUP */
+    unsigned num_children;
+#endif
 } tCmd;
 
-extern tCmd commands[]; /* initialized in cli.c, "NULL" terminated */
+/* A group entry points to a child table of its own, "" terminated and sorted by handle,
+ * e.g. CLI_GROUP("can", "CAN bus commands.", can_cmds). "can tx 1" then runs the "tx" entry
+ * of can_cmds with "1". A group's callback (may be NULL) gets whatever didn't match a child.
+ */
+#if CLI_CFG_GROUPS
+#define CLI_GROUP(handle, description, table) { handle, description, 0, table, sizeof(table)/sizeof(tCmd) - 1 }
+#endif
 
-int CliInit(tCli*);
+/* Variable registry, see cli_vars.c. cli_vars[] is sorted by name and "" terminated */
+enum
+{
+    eCLI_VAR_U8, eCLI_VAR_U16, eCLI_VAR_U32, eCLI_VAR_S8, eCLI_VAR_S16, eCLI_VAR_S32, eCLI_VAR_FLOAT
+};
+
+#define CLI_VAR_RD 1
+#define CLI_VAR_WR 2
+
+typedef struct
+{
+    const char *name;
+    void *addr;
+    unsigned char type;    /* eCLI_VAR_xxx */
+    unsigned char count;   /* > 1 for arrays */
+    unsigned char access;  /* CLI_VAR_RD | CLI_VAR_WR */
+    const char *unit;
+} tCliVar;
+
+extern const tCliVar cli_vars[];
+
+/* Where load/save put and take data. Without GetBuffer, Write/Read go through a block buffer
+ * and are called from the Rx ISR, once per block. */
+typedef struct
+{
+    unsigned char* (*GetBuffer)(unsigned long addr, unsigned len); /* direct access, e.g. RAM */
+    int (*Write)(unsigned long addr, const unsigned char *data, unsigned len);
+    int (*Read)(unsigned long addr, unsigned char *data, unsigned len);
+} tCliSink;
+
+extern const tCliSink cli_ram_sink;
+extern const tCliSink cli_flash_sink; /* cli_cfg.c */
+
+extern const tCmd commands[]; /* initialized in cli_cmds.c, "NULL" terminated. Searched in O(log n) if sorted */
+
+int CliInit(tCli*);  /* UART session, with the hooks from cli_cfg.c */
 int CliDeinit(tCli*);
+int CliAddSession(tCli *p_session); /* any other transport, set its hooks first */
+int CliRemoveSession(tCli *p_session);
+
+void CliPeriodicCheck(void); /* Polling alternative to the LineReady notifier, serves all sessions */
 
 int CliRxISR(void); /* ISR for each char received */
 int CliTxISR(void); /* ISR for each "ready to send char" */
+int CliRxChar(tCli *p_session, char rec_char);
+int CliTxChar(tCli *p_session, char *c);  /* returns 0 and calls DisableUartInt once there's nothing to send */
+int CliHandleSession(tCli *p_session);    /* CliHandleInput on p_session */
 
 char* CliUtoa(unsigned long value, char *str, int base);
 
-void CliSendString(const char *orig); /* Non-blocking send until NULL */
+void CliSendString(const char *orig); /* Non-blocking send until NULL, only the pointer is queued. NULL is ignored */
+int CliFlush(void); /* waits until p_cli's output is sent, then resets its arena. Not from ISRs */
+
+/* Scratch for response text, e.g. CliSendString(CliAllocNum(value, 16)). Valid until the output is
+ * sent: the arena is reset when the Tx queue runs empty outside of a command, or by CliFlush.
+ * For callbacks and the CLI's own ISRs. O(1); when full, a callback waits for its output to go
+ * out and gets the arena from the start (so send each piece before allocating the next), ISRs
+ * and transfers get NULL, and so does anything longer than LEN_ARENA. */
+char* CliAlloc(unsigned len);
+char* CliAllocNum(unsigned long value, int base);
+int CliArenaCmd(char *args);   /* arena - prints the session's arena use */
 int CliHandleInput(void); /* Goes through commands (until "NULL") checking if anything matches */
+const tCmd* CliFindCmd(const tCmd *table, unsigned num, int is_sorted, const char *handle, unsigned len);
+const tCmd* CliLookup(char **line); /* Walks groups along line, leaves line at the arguments */
+void CliListCmds(const tCmd *table);
+void CliComplete(void); /* Tab completion of the word before the cursor */
+int CliExecute(char *line); /* Runs "cmd1; cmd2 && cmd3" (modifies line), returns the last callback's retval */
+
+int CliDefineMacro(const char *name, const char *body); /* empty body deletes the macro */
+const char* CliFindMacro(const char *name);
+int CliRunMacro(const char *name); /* macros are also run by typing their name */
+void CliListMacros(void);
 
 int CliInsertChar(char *str, int position, char character);
+int CliEscKey(unsigned char rec_char); /* decodes a received byte for p_cli, eKEY_* from cli_esc_table.h */
+
+const tCliVar* CliFindVar(const char *name, unsigned len);
+unsigned CliVarSize(const tCliVar *var);
+int CliGetCmd(char *args);      /* get [<name>], lists the registry without a name */
+int CliSetCmd(char *args);      /* set <name> <value>... */
+int CliSnapshotCmd(char *args); /* snapshot [-x] <name>..., -x dumps all raw bytes as one hex line */
+
+int CliLoadCmd(char *args);     /* load [-f] <addr>, see cli_xfer.c for the protocol */
+int CliSaveCmd(char *args);     /* save [-f] <addr> <len> */
+int CliXferIsActive(void);
+void CliXferRxByte(char rec_char);
+int CliXferTxByte(char *c);     /* returns 0 if there's nothing to send now */
+
+int CliCompressCmd(char *args); /* compress [on | off], see cli_lz.c */
+int CliLzTxByte(const char *text, char *c); /* codes text (NULL: nothing queued), returns 0 if there's nothing to send */
+const char* CliTxText(void);    /* text to send next, from p_cli's queue, NULL when it's empty */
+
+int CliCaptureCmd(char *args);  /* capture [on [-t] | off | dump], see cli_capture.c */
+void CliCaptureByte(char c, int is_tx); /* from the ISRs, for p_cli */
 
 // to be implemented
 
@@ -0,0 +1,219 @@
+/*
+ * cli_capture.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* Rx/Tx capture, for replaying a session on the host with tools/cli_replay.c.
+ *
+ * "capture on" starts recording the bytes the calling session receives ("-t": and sends) into
+ * a ring of LEN_CAPTURE bytes, "capture dump" stops and prints it as hex. Each byte is a record
+ *     hdr [delta] byte
+ * with hdr bit 7 set for Tx, bits 0-6 the ms since the previous record, or 127 followed by the
+ * delta as a LEB128 varint when it doesn't fit. A full ring drops its oldest records, the dump
+ * tells how many. One session is recorded at a time, "capture on" from another moves the ring.
+ */
+
+#include "cli.h"
+
+#if CLI_CFG_CAPTURE
+
+#define CAPTURE_TX 0x80
+#define CAPTURE_LONG 0x7F       // delta follows as a varint
+#define LEN_HEX_PIECE ((LEN_ARENA - 4) / 2)  // ring bytes per dump line, "\r\n:<hex>" in one allocation
+
+static struct
+{
+    tCli *p_session;
+    volatile char is_on;
+    char is_tx_on;
+    unsigned head;
+    unsigned tail;
+    unsigned used;
+    unsigned long lost;         // records dropped to make room
+    unsigned long t_last;
+    unsigned char ring[LEN_CAPTURE];
+} capture;
+
+static unsigned CliCaptureRecordLen(unsigned pos)
+{
+    unsigned len = 2;
+
+    if ((capture.ring[pos] & ~CAPTURE_TX) == CAPTURE_LONG)
+    {
+        do
+        {
+            pos = (pos + 1) % LEN_CAPTURE;
+            ++len;
+        } while (capture.ring[pos] & 0x80);
+    }
+
+    return len;
+}
+
+static void CliCapturePut(unsigned char c)
+{
+    capture.ring[capture.head] = c;
+    capture.head = (capture.head + 1) % LEN_CAPTURE;
+    capture.used++;
+}
+
+void CliCaptureByte(char c, int is_tx)
+{
+    unsigned state = 0;
+    unsigned long t_now = 0;
+    unsigned long delta = 0;
+    unsigned len = 0;
+
+    if (!capture.is_on || capture.p_session != p_cli || (is_tx && !capture.is_tx_on))
+    {
+        return;
+    }
+
+    state = CliEnterCritical();  // Rx and Tx ISRs may nest on some ports
+
+    t_now = CliGetTickMs();
+    delta = t_now - capture.t_last;
+    capture.t_last = t_now;
+
+    len = 2;
+    if (delta >= CAPTURE_LONG)
+    {
+        for (unsigned long rest = delta; rest; rest >>= 7, ++len);
+    }
+
+    while (LEN_CAPTURE - capture.used < len)
+    {
+        unsigned drop = CliCaptureRecordLen(capture.tail);
+
+        capture.tail = (capture.tail + drop) % LEN_CAPTURE;
+        capture.used -= drop;
+        capture.lost++;
+    }
+
+    if (delta < CAPTURE_LONG)
+    {
+        CliCapturePut((is_tx ? CAPTURE_TX : 0) | delta);
+    }
+    else
+    {
+        CliCapturePut((is_tx ? CAPTURE_TX : 0) | CAPTURE_LONG);
+        do
+        {
+            CliCapturePut((delta & 0x7F) | (delta > 0x7F ? 0x80 : 0));
+            delta >>= 7;
+        } while (delta);
+    }
+    CliCapturePut((unsigned char)c);
+
+    CliExitCritical(state);
+}
+
+static int CliCaptureDump(void)
+{
+    static const char hex_digits[] = "0123456789ABCDEF";
+    char *text = NULL;
+
+    for (unsigned i = 0, len = 0; i < capture.used; i += len)
+    {
+        len = capture.used - i < LEN_HEX_PIECE ? capture.used - i : LEN_HEX_PIECE;
+        if (!(text = CliAlloc(2 * len + 4)))
+        {
+            return -1;
+        }
+
+        text[0] = '\r';
+        text[1] = '\n';
+        text[2] = ':';
+        for (unsigned j = 0; j < len; ++j)
+        {
+            unsigned char c = capture.ring[(capture.tail + i + j) % LEN_CAPTURE];
+
+            text[3 + 2 * j] = hex_digits[c >> 4];
+            text[4 + 2 * j] = hex_digits[c & 0xF];
+        }
+        text[3 + 2 * len] = 0;
+
+        CliSendString(text);
+    }
+
+    CliSendString("\r\n:");  // an empty line ends the dump
+
+    return 0;
+}
+
+int CliCaptureCmd(char *args)
+{
+    if (args && (!strcmp(args, "on") || !strcmp(args, "on -t")))
+    {
+        unsigned state = CliEnterCritical();
+
+        capture.is_on = 0;
+        capture.p_session = p_cli;
+        capture.is_tx_on = args[2] != 0;
+        capture.head = 0;
+        capture.tail = 0;
+        capture.used = 0;
+        capture.lost = 0;
+        capture.t_last = CliGetTickMs();
+        capture.is_on = 1;
+
+        CliExitCritical(state);
+        return 0;
+    }
+
+    if (args && !strcmp(args, "off"))
+    {
+        capture.is_on = 0;
+        return 0;
+    }
+
+    if (args && *args && strcmp(args, "dump"))
+    {
+        CliSendString("capture [on [-t] | off | dump]");
+        return -1;
+    }
+
+    if (args && *args)
+    {
+        capture.is_on = 0;  // the ring stays as it is while it's printed
+    }
+
+    /* "capture: <n> B, <n> lost, rx+tx, on" and the session's drop counters */
+    CliSendString("capture: ");
+    CliSendString(CliAllocNum(capture.used, 10));
+    CliSendString(" B, ");
+    CliSendString(CliAllocNum(capture.lost, 10));
+    CliSendString(capture.is_tx_on ? " lost, rx+tx" : " lost, rx");
+    CliSendString(capture.is_on && capture.p_session == p_cli ? ", on" : ", off");
+    CliSendString("; drops: ");
+    CliSendString(CliAllocNum(p_cli->rx_drops, 10));
+    CliSendString(" rx, ");
+    CliSendString(CliAllocNum(p_cli->tx_drops, 10));
+    CliSendString(" tx");
+
+    return args && *args ? CliCaptureDump() : 0;
+}
+
+#endif /* CLI_CFG_CAPTURE */
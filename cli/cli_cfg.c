@@ -5,7 +5,12 @@
  *      Author: avatar
  */
 
-#include "cli_cfg.h"
+#include "cli.h"
+
+#if !CLI_CFG_HOST  // the Linux port is in cli_host.c
+
+static volatile unsigned long tick_ms = 0;
+static volatile char is_line_ready = 0;
 
 void CliDisableUartInt(void)
 {
@@ -20,6 +25,71 @@ void CliEnableUartInt(void)
     LPUART1->CTRL |= 0x800000;
 }
 
+unsigned CliEnterCritical(void)
+{
+    unsigned primask = 0;
+
+    __asm volatile ("mrs %0, primask\n cpsid i" : "=r" (primask) :: "memory");
+
+    return primask;
+}
+
+void CliExitCritical(unsigned primask)
+{
+    __asm volatile ("msr primask, %0" :: "r" (primask) : "memory");
+}
+
+int CliIsInIsr(void)
+{
+    unsigned ipsr = 0;
+
+    __asm volatile ("mrs %0, ipsr" : "=r" (ipsr));
+
+    return ipsr != 0;
+}
+
+unsigned long CliGetCycles(void)
+{
+    return DWT_CYCCNT_REG;
+}
+
+void CliLineReady(void)
+{
+    // Post to your RTOS queue or set an event flag here instead, if you have one
+    is_line_ready = 1;
+}
+
+void CliTxIdle(void)
+{
+}
+
+void CliWaitForLine(void)
+{
+    /* Interrupts are masked between the check and WFI, so a line completing in between
+     * still wakes us up: WFI returns on a pending interrupt even with PRIMASK set. Any other
+     * interrupt wakes us up too, SysTick for CliTick every ms among them, and we sleep again. */
+    __asm volatile ("cpsid i" ::: "memory");
+    while (!is_line_ready)
+    {
+        __asm volatile ("wfi");
+        __asm volatile ("cpsie i\n isb\n cpsid i" ::: "memory");  // let the pending ISR run
+    }
+    is_line_ready = 0;
+    __asm volatile ("cpsie i" ::: "memory");
+
+    CliPeriodicCheck();  // whichever session has a line
+}
+
+void CliTick(void)
+{
+    ++tick_ms;
+}
+
+unsigned long CliGetTickMs(void)
+{
+    return tick_ms;
+}
+
 int CliInitUart()
 {
     // Remember to configure the clocks for the peripheric
@@ -39,9 +109,121 @@ int CliInitUart()
      * Rx Enable: 18 = 1
      */
 
+    // Cycle counter for CliGetCycles()
+    DEMCR_REG |= DEMCR_TRCENA;
+    DWT_CYCCNT_REG = 0;
+    DWT_CTRL_REG |= DWT_CYCCNTENA;
+
     // Configure interrupts (remember to config NVIC if using ARM)
     S32_NVIC->ICPR[UART1_IRQ_REG] = UART1_IRQ_BIT;    /* Check page 117 of RM */
     S32_NVIC->ISER[UART1_IRQ_REG] = UART1_IRQ_BIT;
 
     return 0;
 }
+
+#if CLI_CFG_MACROS
+int CliStoreMacros(const char *pool, unsigned len)
+{
+    // Write pool to flash/EEPROM here if macros should survive a reset
+
+    return -1;
+}
+
+int CliLoadMacros(char *pool, unsigned len)
+{
+    // Read back what CliStoreMacros wrote, return non-zero if there is nothing valid
+
+    return -1;
+}
+#endif
+
+#if CLI_CFG_XFER
+/* P-Flash through the FTFC: sectors are erased when a block starts on a sector boundary and
+ * phrases already holding the data are skipped, so the go-back-N resends from a block on are
+ * rewritten fine. A load must start on a sector boundary, or on erased flash. This runs in the
+ * Rx ISR and erasing stalls it for up to ~130 ms, use "cli_xfer.py -f --window 1". */
+#define FLASH_SECTOR 4096
+#define FLASH_PHRASE 8
+#define FLASH_CMD_PGM8 0x07
+#define FLASH_CMD_ERSSCR 0x09
+#define FLASH_FCCOB(n) FTFC->FCCOB[((n) & ~3) | (3 - ((n) & 3))]  // FCCOB0 is FCCOB[3]
+
+__attribute__((section(".code_ram"), noinline))
+static unsigned char CliFlashLaunch(void)  // from RAM, the flash can't be read meanwhile
+{
+    FTFC->FSTAT = FTFC_FSTAT_ACCERR_MASK | FTFC_FSTAT_FPVIOL_MASK;
+    FTFC->FSTAT = FTFC_FSTAT_CCIF_MASK;
+    while (!(FTFC->FSTAT & FTFC_FSTAT_CCIF_MASK))
+    {
+    }
+
+    return FTFC->FSTAT & (FTFC_FSTAT_ACCERR_MASK | FTFC_FSTAT_FPVIOL_MASK | FTFC_FSTAT_MGSTAT0_MASK);
+}
+
+static int CliFlashCmd(unsigned char cmd, unsigned long addr, const unsigned char *phrase)
+{
+    unsigned primask = 0;
+    unsigned char error = 0;
+    int i = 0;
+
+    FLASH_FCCOB(0) = cmd;
+    FLASH_FCCOB(1) = addr >> 16;
+    FLASH_FCCOB(2) = addr >> 8;
+    FLASH_FCCOB(3) = addr;
+    for (i = 0; phrase && i < FLASH_PHRASE; i++)
+    {
+        FLASH_FCCOB(4 + i) = phrase[i];
+    }
+
+    primask = CliEnterCritical();  // vectors and other ISRs live in flash too
+    error = CliFlashLaunch();
+    CliExitCritical(primask);
+
+    return error ? -1 : 0;
+}
+
+static int CliFlashWrite(unsigned long addr, const unsigned char *data, unsigned len)
+{
+    unsigned char phrase[FLASH_PHRASE];
+    unsigned n = 0;
+
+    if (addr % FLASH_PHRASE)
+    {
+        return -1;  // blocks are a multiple of a phrase, so is every block's address
+    }
+
+    if (!(addr % FLASH_SECTOR) && CliFlashCmd(FLASH_CMD_ERSSCR, addr, 0))
+    {
+        return -1;
+    }
+
+    for (; len; addr += FLASH_PHRASE, data += n, len -= n)
+    {
+        n = len < FLASH_PHRASE ? len : FLASH_PHRASE;
+        memset(phrase, 0xFF, FLASH_PHRASE);  // the last phrase is padded as erased
+        memcpy(phrase, data, n);
+
+        if (!memcmp((const void*)addr, phrase, FLASH_PHRASE))
+        {
+            continue;  // resent block, or erased and the data is erased too
+        }
+        if (CliFlashCmd(FLASH_CMD_PGM8, addr, phrase))
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int CliFlashRead(unsigned long addr, unsigned char *data, unsigned len)
+{
+    memcpy(data, (const void*)addr, len);  // flash is memory mapped
+
+    return 0;
+}
+
+const tCliSink cli_flash_sink = { 0, CliFlashWrite, CliFlashRead };
+#endif
+
+#endif /* !CLI_CFG_HOST */
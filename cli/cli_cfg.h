@@ -26,6 +26,31 @@
 #ifndef CLI_CFG_H_
 #define CLI_CFG_H_
 
+#ifndef CLI_CFG_HOST
+#if defined(__linux__)
+#define CLI_CFG_HOST 1  /* Linux build, sessions over sockets, ptys or stdio, see cli_host.c */
+#else
+#define CLI_CFG_HOST 0
+#endif
+#endif
+
+#if CLI_CFG_HOST
+
+#define RX_REG_ADDR NULL
+#define TX_REG_ADDR NULL
+
+#ifndef CLI_CFG_XFER
+#define CLI_CFG_XFER 0  /* load/save wait inside the callback for the ISRs, the event loop can't run then */
+#endif
+#ifndef CLI_MAX_SESSIONS
+#define CLI_MAX_SESSIONS 16
+#endif
+#ifndef CLI_ISR_BUDGET
+#define CLI_ISR_BUDGET 10000    /* ns per Rx/Tx byte, CliGetCycles() counts ns here: a target byte time of work on a desktop core, with room for sanitizers */
+#endif
+
+#else
+
 #include "S32K148.h"
 
 #define RX_REG_ADDR (&LPUART1->DATA); // address of UART receive buffer here
@@ -42,11 +67,132 @@ configuring a particular interrupt)*/
 #define UART1_IRQ_REG (UART1_IRQ / 32)
 #define UART1_IRQ_BIT (1<<(UART1_IRQ % 32))
 #define UART1_IRQ_IP_BIT (1<<(8*(UART1_IRQ % 4)+4))
+
+/* Cortex-M4 cycle counter (DWT) */
+#define DEMCR_REG (*(volatile unsigned*)0xE000EDFC)
+#define DEMCR_TRCENA (1<<24)
+#define DWT_CTRL_REG (*(volatile unsigned*)0xE0001000)
+#define DWT_CYCCNT_REG (*(volatile unsigned*)0xE0001004)
+#define DWT_CYCCNTENA 1
 // \+++ Very specific, better left out of template +++
 
+#endif /* CLI_CFG_HOST */
+
+/* Features, 1 to build in, 0 to compile out completely. All of these and the sizes below can
+ * also be set with -D. tools/cli_size.sh prints what each one costs. */
+#ifndef CLI_CFG_HISTORY
+#define CLI_CFG_HISTORY 1       /* up/down recall */
+#endif
+#ifndef CLI_CFG_NAVIGATION
+#define CLI_CFG_NAVIGATION 1    /* cursor keys, home/end, word motion, kill keys, delete */
+#endif
+#ifndef CLI_CFG_COMPLETION
+#define CLI_CFG_COMPLETION 1    /* tab completion */
+#endif
+#ifndef CLI_CFG_GROUPS
+#define CLI_CFG_GROUPS 1        /* nested command tables, CLI_GROUP */
+#endif
+#ifndef CLI_CFG_MACROS
+#define CLI_CFG_MACROS 1        /* "macro" command and the macro pool */
+#endif
+#ifndef CLI_CFG_VARS
+#define CLI_CFG_VARS 1          /* get/set/snapshot, cli_vars.c */
+#endif
+#ifndef CLI_CFG_XFER
+#define CLI_CFG_XFER 1          /* load/save, cli_xfer.c */
+#endif
+#ifndef CLI_CFG_LATENCY
+#define CLI_CFG_LATENCY 1       /* CR to callback cycles, "latency" command */
+#endif
+#ifndef CLI_CFG_CAPTURE
+#define CLI_CFG_CAPTURE 0       /* "capture" records Rx (and Tx) bytes for tools/cli_replay.c */
+#endif
+#ifndef CLI_CFG_COMPRESS
+#define CLI_CFG_COMPRESS 0      /* "compress on" LZ codes a session's output, see tools/cli_lzterm.py */
+#endif
+#ifndef CLI_CFG_DEBUG
+#define CLI_CFG_DEBUG 0         /* sanity checks of the command tables in CliInit */
+#endif
+
+/* Sizes in bytes, unless noted */
+#ifndef LEN_STD_STR
+#define LEN_STD_STR 64          /* input line, long enough for a few "cmd1; cmd2 && cmd3" */
+#endif
+#ifndef LEN_HISTORY
+#define LEN_HISTORY 128         /* recalled lines packed back to back, the oldest go first */
+#endif
+#ifndef NUM_OUT_MSG_QUEUE
+#define NUM_OUT_MSG_QUEUE 16    /* strings queued by CliSendString (one pointer each), up to 256 */
+#endif
+#ifndef CLI_MACRO_POOL_SIZE
+#define CLI_MACRO_POOL_SIZE 128 /* shared by all macro names and bodies */
+#endif
+#ifndef LEN_ARENA
+#define LEN_ARENA 80            /* per session scratch for response text, see CliAlloc, and the echo */
+#endif
+#ifndef LEN_SNAPSHOT
+#define LEN_SNAPSHOT 128        /* raw bytes copied atomically by "snapshot" */
+#endif
+#ifndef LEN_XFER_BLOCK
+#define LEN_XFER_BLOCK 128      /* load/save block payload, 128 (SOH) or 1024 (STX) */
+#endif
+#ifndef CLI_XFER_WINDOW
+#define CLI_XFER_WINDOW 4       /* blocks "save" sends ahead of the receiver's ACKs */
+#endif
+#ifndef CLI_XFER_TIMEOUT_MS
+#define CLI_XFER_TIMEOUT_MS 10000 /* load/save give up after this long without a byte from the host */
+#endif
+#ifndef LEN_CAPTURE
+#define LEN_CAPTURE 512         /* capture ring, about 2 B per recorded byte */
+#endif
+#ifndef LEN_LZ_WINDOW
+#define LEN_LZ_WINDOW 128       /* per session history "compress" matches against, up to 256 */
+#endif
+#ifndef CLI_ISR_BUDGET
+#define CLI_ISR_BUDGET 4000     /* CliGetCycles() per Rx/Tx byte, about a byte time at 115200 baud and 48 MHz */
+#endif
+#ifndef CLI_MAX_SESSIONS
+#define CLI_MAX_SESSIONS 1      /* tCli instances served at once (one pointer each), see CliAddSession */
+#endif
+
+#if CLI_CFG_HOST && CLI_CFG_XFER
+#error "load/save need interrupt driven sessions"
+#endif
+#if LEN_LZ_WINDOW > 256
+#error "match offsets are one byte"
+#endif
+#if LEN_ARENA < LEN_STD_STR + 12
+#error "a redrawn line and its cursor move are one piece of the arena"
+#endif
+
 int CliInitUart(void);
 
 void CliDisableUartInt(void);
 void CliEnableUartInt(void);
 
+unsigned CliEnterCritical(void); /* returns the state to pass to CliExitCritical */
+void CliExitCritical(unsigned state);
+int CliIsInIsr(void); /* CliSendString waits for queue space only outside of ISRs */
+
+unsigned long CliGetCycles(void); /* free running, for latency measurements */
+void CliLineReady(void);
+void CliTxIdle(void);
+void CliWaitForLine(void); /* sleeps (WFI) until a line is ready, then handles it */
+
+unsigned long CliGetTickMs(void);
+void CliTick(void); /* call every ms, e.g. from SysTick_Handler, for load/save and capture */
+
+int CliStoreMacros(const char *pool, unsigned len);
+int CliLoadMacros(char *pool, unsigned len);
+
+#if CLI_CFG_HOST
+int CliHostInit(void);
+int CliHostListenUnix(const char *path);
+int CliHostListenTcp(unsigned short port);   /* loopback only */
+int CliHostOpen(int in_fd, int out_fd);      /* e.g. stdin/stdout or a tty, put in raw mode while open */
+int CliHostOpenPty(char *name, unsigned len); /* name of the slave side, for screen/minicom */
+int CliHostPoll(int timeout_ms);             /* serves whatever is ready, returns the number of sessions */
+void CliHostSetIsr(int is_isr);              /* for simulations, e.g. tools/cli_replay.c: what CliIsInIsr returns */
+#endif
+
 #endif /* CLI_CFG_H_ */
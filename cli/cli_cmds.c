@@ -26,84 +26,191 @@
  */
 
 #include "cli.h"
+#include <stdint.h>
+#include <stdlib.h>
 // include any hardware support header you need here...
 
 int Help(char *args)
 {
-    /* Print cmd descriptions */
-    //CliSendString("\n\rHelp yourself! (WIP, will print descriptions)");
+    /* Print cmd descriptions, of a group if one is given */
+    const tCmd *cmd = NULL;
 
-    for (unsigned i = 0; commands[i].handle[0]; ++i)
+    if (!args || !args[0])
     {
-        if (commands[i].handle)
-        {
-            CliSendString(commands[i].handle);
-            CliSendString(" - ");
+        CliListCmds(commands);
+        return 0;
+    }
 
-            if (commands[i].description)
-            {
-                CliSendString(commands[i].description);
-                CliSendString("\r\n");
-            }
-        }
+    cmd = CliLookup(&args);
+
+    if (!cmd || *args)
+    {
+        CliSendString("unknown: ");
+        CliSendString(args);
+        return -1;
+    }
+
+#if CLI_CFG_GROUPS
+    if (cmd->children)
+    {
+        CliListCmds(cmd->children);
+    }
+    else if (cmd->description)
+#else
+    if (cmd->description)
+#endif
+    {
+        CliSendString(cmd->description);
     }
 
     return 0;
 }
 
+static uint32_t hello_count = 0;
+#if CLI_CFG_VARS
+static uint8_t led_duty = 50;
+#endif
+
 int SayHello(char *args)
 {
     CliSendString("Hello World!");
+    ++hello_count;
     
     return 0;
 }
 
+#if !CLI_CFG_HOST  // raw memory access, not for every socket client of a process
 int ReadAddr(char *args)
 {
-    unsigned long *addr = 0;
+    unsigned long addr = 0;
     unsigned long value = 0;
     char *arg_end = NULL;
-    char addr_str[33] = { 0 };
-    char value_str[33] = { 0 };
-    
+
     addr = strtoul(args, &arg_end, 0);
-    *arg_end = 0; /*null terminate after first arg*/
-    
-    CliUtoa(addr, addr_str, 16);
-    
-    CliSendString("read 0x");
-    CliSendString(addr_str);
-    CliSendString(": ");
-    
-    if (addr)
+    if (arg_end == args || !addr)
     {
-        value = *addr;
-        
-        CliUtoa(value, value_str, 16);
-        
-        CliSendString("0x");
-        CliSendString(value_str);
+        CliSendString("read <addr>");
+        return -1;
     }
-    
+
+    value = *(volatile uint32_t*)addr;
+
+    CliSendString("read 0x");
+    CliSendString(CliAllocNum(addr, 16));
+    CliSendString(": 0x");
+    CliSendString(CliAllocNum(value, 16));
+
     return 0;
 }
 
 int WriteAddr(char *args)
 {
-    CliSendString("write: ");
-    CliSendString(args);
-    
+    unsigned long addr = 0;
+    unsigned long value = 0;
+    char *arg_end = NULL;
+
+    addr = strtoul(args, &arg_end, 0);
+    if (arg_end != args)
+    {
+        args = arg_end;
+        value = strtoul(args, &arg_end, 0);
+    }
+
+    if (arg_end == args || !addr)
+    {
+        CliSendString("write <addr> <value>");
+        return -1;
+    }
+
+    *(volatile uint32_t*)addr = value;
+
+    return 0;
+}
+#endif
+
+#if CLI_CFG_LATENCY
+int Latency(char *args)
+{
+    CliSendString("CR to callback, last ");
+    CliSendString(CliAllocNum(p_cli->last_latency, 10));
+    CliSendString(" max ");
+    CliSendString(CliAllocNum(p_cli->max_latency, 10));
+    CliSendString(" cycles; per byte, Rx max ");
+    CliSendString(CliAllocNum(p_cli->rx_byte_max, 10));
+    CliSendString(" Tx max ");
+    CliSendString(CliAllocNum(p_cli->tx_byte_max, 10));
+    CliSendString(", ");
+    CliSendString(CliAllocNum(p_cli->over_budget, 10));
+    CliSendString(" over ");
+    CliSendString(CliAllocNum(CLI_ISR_BUDGET, 10));
+
+    p_cli->max_latency = 0;
+    p_cli->rx_byte_max = 0;
+    p_cli->tx_byte_max = 0;
+    p_cli->over_budget = 0;
+
     return 0;
 }
+#endif
+
+#if CLI_CFG_MACROS
+int Macro(char *args)
+{
+    char *body = args;
+
+    if (!args || !args[0])
+    {
+        CliListMacros();
+        return 0;
+    }
+
+    while (*body && *body != ' ' && *body != '\t')
+    {
+        ++body;
+    }
+
+    if (*body)
+    {
+        *body++ = 0;
+    }
+
+    /* body is usually quoted so that ';' and "&&" don't split the macro command itself */
+    if (*body == '"')
+    {
+        char *end = strrchr(++body, '"');
+        if (end)
+        {
+            *end = 0;
+        }
+    }
+
+    if (CliDefineMacro(args, body))
+    {
+        CliSendString("macro: no space or bad name");
+        return -1;
+    }
+
+    return 0;
+}
+#endif
 
 
 /* @formatter:off */
 
-tCmd commands[] =
+#if CLI_CFG_VARS
+const tCliVar cli_vars[] =  /* sorted by name */
+{
+        { "hello_count", &hello_count, eCLI_VAR_U32, 1, CLI_VAR_RD | CLI_VAR_WR, "" },
+        { "led_duty", &led_duty, eCLI_VAR_U8, 1, CLI_VAR_RD | CLI_VAR_WR, "%" },
+        { "", 0 }
+};
+#endif
+
+const tCmd commands[] =
 {
         {
             "help",
-            "Prints commands descriptions.",
+            "help [<group>...] - prints commands descriptions.",
             Help
         },
         {
@@ -111,6 +218,7 @@ tCmd commands[] =
             "Prints a greeting.",
             SayHello
         },
+#if !CLI_CFG_HOST
         {
             "read",
             "read <addr 0xh/d>",
@@ -118,9 +226,72 @@ tCmd commands[] =
         },
         {
             "write",
-            "read <addr 0xh/d> <value 0xh/d>",
+            "write <addr 0xh/d> <value 0xh/d>",
             WriteAddr
         },
+#endif
+#if CLI_CFG_MACROS
+        {
+            "macro",
+            "macro [<name> [\"cmd1; cmd2 && cmd3\"]], no body deletes",
+            Macro
+        },
+#endif
+#if CLI_CFG_VARS
+        {
+            "get",
+            "get [<var>] - without <var> lists all variables",
+            CliGetCmd
+        },
+        {
+            "set",
+            "set <var> <value>...",
+            CliSetCmd
+        },
+        {
+            "snapshot",
+            "snapshot [-x] <var>... - atomic read, -x as one hex line",
+            CliSnapshotCmd
+        },
+#endif
+#if CLI_CFG_XFER
+        {
+            "load",
+            "load [-f] <addr> - binary upload, use tools/cli_xfer.py",
+            CliLoadCmd
+        },
+        {
+            "save",
+            "save [-f] <addr> <len> - binary download, use tools/cli_xfer.py",
+            CliSaveCmd
+        },
+#endif
+        {
+            "arena",
+            "arena [-r] - response scratch use, -r resets the max",
+            CliArenaCmd
+        },
+#if CLI_CFG_COMPRESS
+        {
+            "compress",
+            "compress [on | off] - LZ coded output, use tools/cli_lzterm.py",
+            CliCompressCmd
+        },
+#endif
+#if CLI_CFG_CAPTURE
+        {
+            "capture",
+            "capture [on [-t] | off | dump] - records Rx (-t: and Tx) for tools/cli_replay.c",
+            CliCaptureCmd
+        },
+#endif
+#if CLI_CFG_LATENCY
+        {
+            "latency",
+            "Prints CR to callback latency and Rx/Tx cycles per byte (and resets the max).",
+            Latency
+        },
+#endif
         {
             "null_test",
             "Just a test of NULL callback.",
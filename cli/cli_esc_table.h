@@ -0,0 +1,190 @@
+/*
+ * cli_esc_table.h
+ *
+ * Generated by tools/gen_esc_table.py, do not edit.
+ *
+ */
+
+#ifndef CLI_ESC_TABLE_H_
+#define CLI_ESC_TABLE_H_
+
+enum
+{
+    eESC_GROUND, eESC_ESC, eESC_CSI, eESC_SS3, eESC_CSI_SKIP
+};
+
+enum
+{
+    eCL_OTHER, eCL_CTRL, eCL_DEL, eCL_ESC, eCL_PRINT, eCL_DIGIT, eCL_SEMI, eCL_TILDE, eCL_LBRCKT, eCL_O, eCL_FINAL, eCL_INTER, eNUM_CLASSES
+};
+
+enum
+{
+    eACT_NONE, eACT_INSERT, eACT_CTRL, eACT_ALT, eACT_CLEAR, eACT_PARAM, eACT_NEXT_PARAM, eACT_CSI, eACT_TILDE, eACT_SS3
+};
+
+enum
+{
+    eKEY_NONE, eKEY_INSERT, eKEY_ENTER, eKEY_TAB, eKEY_BACKSPACE, eKEY_DELETE,
+    eKEY_UP, eKEY_DOWN, eKEY_RIGHT, eKEY_LEFT, eKEY_HOME, eKEY_END,
+    eKEY_WORD_LEFT, eKEY_WORD_RIGHT, eKEY_KILL_EOL, eKEY_KILL_BOL, eKEY_KILL_WORD, eKEY_REDRAW,
+    eKEY_ABORT
+};
+
+#define ESC_NEXT(entry) ((entry) & 0x07)
+#define ESC_ACTION(entry) ((entry) >> 3)
+
+static const unsigned char esc_classes[128] =
+{
+    eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL,
+    eCL_DEL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL,
+    eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL,
+    eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_ESC, eCL_CTRL, eCL_CTRL, eCL_CTRL, eCL_CTRL,
+    eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER,
+    eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER,
+    eCL_DIGIT, eCL_DIGIT, eCL_DIGIT, eCL_DIGIT, eCL_DIGIT, eCL_DIGIT, eCL_DIGIT, eCL_DIGIT,
+    eCL_DIGIT, eCL_DIGIT, eCL_INTER, eCL_SEMI, eCL_INTER, eCL_INTER, eCL_INTER, eCL_INTER,
+    eCL_PRINT, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL,
+    eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_O,
+    eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL,
+    eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_LBRCKT, eCL_PRINT, eCL_PRINT, eCL_PRINT, eCL_PRINT,
+    eCL_PRINT, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL,
+    eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL,
+    eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_FINAL,
+    eCL_FINAL, eCL_FINAL, eCL_FINAL, eCL_PRINT, eCL_PRINT, eCL_PRINT, eCL_TILDE, eCL_DEL
+};
+
+static const unsigned char esc_transitions[5][eNUM_CLASSES] =
+{
+    {   /* eESC_GROUND */
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_ESC | eACT_NONE << 3,
+        eESC_GROUND | eACT_INSERT << 3,
+        eESC_GROUND | eACT_INSERT << 3,
+        eESC_GROUND | eACT_INSERT << 3,
+        eESC_GROUND | eACT_INSERT << 3,
+        eESC_GROUND | eACT_INSERT << 3,
+        eESC_GROUND | eACT_INSERT << 3,
+        eESC_GROUND | eACT_INSERT << 3,
+        eESC_GROUND | eACT_INSERT << 3
+    },
+    {   /* eESC_ESC */
+        eESC_GROUND | eACT_ALT << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_GROUND | eACT_ALT << 3,
+        eESC_ESC | eACT_NONE << 3,
+        eESC_GROUND | eACT_ALT << 3,
+        eESC_GROUND | eACT_ALT << 3,
+        eESC_GROUND | eACT_ALT << 3,
+        eESC_GROUND | eACT_ALT << 3,
+        eESC_CSI | eACT_CLEAR << 3,
+        eESC_SS3 | eACT_CLEAR << 3,
+        eESC_GROUND | eACT_ALT << 3,
+        eESC_GROUND | eACT_ALT << 3
+    },
+    {   /* eESC_CSI */
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_ESC | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_CSI | eACT_PARAM << 3,
+        eESC_CSI | eACT_NEXT_PARAM << 3,
+        eESC_GROUND | eACT_TILDE << 3,
+        eESC_CSI | eACT_NONE << 3,
+        eESC_GROUND | eACT_CSI << 3,
+        eESC_GROUND | eACT_CSI << 3,
+        eESC_CSI_SKIP | eACT_NONE << 3
+    },
+    {   /* eESC_SS3 */
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_ESC | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_SS3 | eACT_PARAM << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_SS3 << 3,
+        eESC_GROUND | eACT_SS3 << 3,
+        eESC_GROUND | eACT_NONE << 3
+    },
+    {   /* eESC_CSI_SKIP */
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_GROUND | eACT_CTRL << 3,
+        eESC_ESC | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_CSI_SKIP | eACT_NONE << 3,
+        eESC_CSI_SKIP | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_GROUND | eACT_NONE << 3,
+        eESC_CSI_SKIP | eACT_NONE << 3
+    }
+};
+
+static const unsigned char esc_ctrl_keys[32] =  /* DEL (127) is BACKSPACE too */
+{
+    eKEY_NONE, eKEY_HOME, eKEY_LEFT, eKEY_ABORT, eKEY_DELETE, eKEY_END,
+    eKEY_RIGHT, eKEY_NONE, eKEY_BACKSPACE, eKEY_TAB, eKEY_ENTER, eKEY_KILL_EOL,
+    eKEY_REDRAW, eKEY_ENTER, eKEY_DOWN, eKEY_NONE, eKEY_UP, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_KILL_BOL, eKEY_NONE, eKEY_KILL_WORD,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE
+};
+
+static const unsigned char esc_alt_keys[128] =
+{
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_KILL_WORD, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_WORD_LEFT, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_WORD_RIGHT, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_WORD_LEFT, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_WORD_RIGHT, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_KILL_WORD
+};
+
+#define ESC_FIRST_FINAL 0x40
+
+static const unsigned char esc_final_keys[63] =
+{
+    eKEY_NONE, eKEY_UP, eKEY_DOWN, eKEY_RIGHT, eKEY_LEFT, eKEY_NONE,
+    eKEY_END, eKEY_NONE, eKEY_HOME, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_UP, eKEY_DOWN, eKEY_WORD_RIGHT,
+    eKEY_WORD_LEFT, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE, eKEY_NONE,
+    eKEY_NONE, eKEY_NONE, eKEY_NONE
+};
+
+static const unsigned char esc_tilde_keys[9] =
+{
+    eKEY_NONE, eKEY_HOME, eKEY_NONE, eKEY_DELETE, eKEY_END, eKEY_NONE,
+    eKEY_NONE, eKEY_HOME, eKEY_END
+};
+
+#endif /* CLI_ESC_TABLE_H_ */
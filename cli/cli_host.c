@@ -0,0 +1,492 @@
+/*
+ * cli_host.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* Linux port, used instead of cli_cfg.c when CLI_CFG_HOST is set.
+ *
+ * Every connection on a Unix-domain or loopback TCP socket, every pty and every fd pair given
+ * to CliHostOpen is a session with its own tCli. One epoll loop (CliHostPoll) feeds received
+ * bytes to CliRxChar and runs complete lines right away, all from one thread, so there is no
+ * locking. Output is written out by the EnableUartInt hook as soon as it is queued, which keeps
+ * the rule that queued strings only have to outlive the Tx drain; a peer that doesn't read for
+ * CLI_HOST_TX_TIMEOUT_MS is dropped. That also puts the echo's write() into the per byte Rx time
+ * "latency" reports; tools/cli_replay.c measures the ISR paths alone.
+ */
+
+#define _GNU_SOURCE
+#include "cli.h"
+
+#if CLI_CFG_HOST
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define CLI_HOST_MAX_LISTENERS 4
+#define CLI_HOST_MAX_EVENTS 16
+#define CLI_HOST_TX_TIMEOUT_MS 1000
+#define LEN_HOST_IO 256
+
+typedef struct
+{
+    tCli cli;
+    int in_fd;          // -1 when the slot is free
+    int out_fd;
+    int pty_slave_fd;   // kept open, or reading the master fails while no terminal is attached
+    char is_owned;      // close the fds with the session
+    char is_tty;        // restore saved_tio on close
+    char is_dead;       // write failed, closed on the next poll
+    struct termios saved_tio;
+} tCliHostSession;
+
+static int epoll_fd = -1;
+static int listen_fds[CLI_HOST_MAX_LISTENERS] = { -1, -1, -1, -1 };
+static tCliHostSession host_sessions[CLI_MAX_SESSIONS];
+static char is_in_isr = 0;  // see CliHostSetIsr
+
+/* epoll data: sessions by index, listeners after them */
+#define EV_LISTENER(i) (CLI_MAX_SESSIONS + (i))
+
+unsigned CliEnterCritical(void)
+{
+    return 0;  // everything runs on the poll thread
+}
+
+void CliExitCritical(unsigned state)
+{
+}
+
+int CliIsInIsr(void)
+{
+    return is_in_isr;
+}
+
+void CliHostSetIsr(int is_isr)
+{
+    is_in_isr = is_isr;
+}
+
+unsigned long CliGetCycles(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return t.tv_sec * 1000000000UL + t.tv_nsec;  // "cycles" are ns here
+}
+
+unsigned long CliGetTickMs(void)
+{
+    return CliGetCycles() / 1000000;
+}
+
+void CliTick(void)
+{
+}
+
+void CliLineReady(void)
+{
+    // CliHostPoll checks was_input_received after every byte
+}
+
+void CliTxIdle(void)
+{
+}
+
+void CliWaitForLine(void)
+{
+    CliHostPoll(-1);
+}
+
+int CliInitUart(void)
+{
+    return 0;  // no UART session on the host, see CliHostOpen for a tty
+}
+
+void CliDisableUartInt(void)
+{
+}
+
+void CliEnableUartInt(void)
+{
+}
+
+#if CLI_CFG_MACROS
+int CliStoreMacros(const char *pool, unsigned len)
+{
+    return -1;
+}
+
+int CliLoadMacros(char *pool, unsigned len)
+{
+    return -1;
+}
+#endif
+
+static void CliHostWrite(tCliHostSession *session, const char *data, unsigned len)
+{
+    struct pollfd pfd = { session->out_fd, POLLOUT, 0 };
+    ssize_t written = 0;
+
+    while (len && !session->is_dead)
+    {
+        written = write(session->out_fd, data, len);
+        if (written > 0)
+        {
+            data += written;
+            len -= written;
+        }
+        else if (written < 0 && errno == EAGAIN)
+        {
+            if (poll(&pfd, 1, CLI_HOST_TX_TIMEOUT_MS) <= 0)
+            {
+                session->is_dead = 1;
+            }
+        }
+        else if (written < 0 && errno != EINTR)
+        {
+            session->is_dead = 1;
+        }
+    }
+}
+
+static void CliHostKick(void)  // EnableUartInt of host sessions
+{
+    tCliHostSession *session = p_cli->transport;
+    char out[LEN_HOST_IO];
+    unsigned len = 0;
+
+    /* a dead session still drains its queue, so CliSendString never waits on it */
+    while (CliTxChar(p_cli, &out[len]))
+    {
+        if (++len == LEN_HOST_IO)
+        {
+            CliHostWrite(session, out, len);
+            len = 0;
+        }
+    }
+
+    CliHostWrite(session, out, len);
+}
+
+static void CliHostNop(void)
+{
+}
+
+int CliHostInit(void)
+{
+    for (unsigned i = 0; i < CLI_MAX_SESSIONS; ++i)
+    {
+        host_sessions[i].in_fd = -1;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    return epoll_fd < 0 ? -1 : 0;
+}
+
+static int CliHostWatch(int fd, unsigned id)
+{
+    struct epoll_event ev = { 0 };
+
+    ev.events = EPOLLIN;
+    ev.data.u32 = id;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void CliHostClose(tCliHostSession *session)
+{
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, session->in_fd, NULL);
+    CliRemoveSession(&session->cli);
+
+    if (session->is_tty)
+    {
+        tcsetattr(session->in_fd, TCSANOW, &session->saved_tio);
+    }
+
+    if (session->is_owned)
+    {
+        close(session->in_fd);
+        if (session->out_fd != session->in_fd)
+        {
+            close(session->out_fd);
+        }
+    }
+
+    if (session->pty_slave_fd >= 0)
+    {
+        close(session->pty_slave_fd);
+    }
+
+    session->in_fd = -1;
+}
+
+static int CliHostAdd(int in_fd, int out_fd, char is_owned)
+{
+    tCliHostSession *session = NULL;
+    unsigned i = 0;
+
+    for (i = 0; i < CLI_MAX_SESSIONS && host_sessions[i].in_fd >= 0; ++i);
+    if (i == CLI_MAX_SESSIONS)
+    {
+        return -1;
+    }
+
+    session = &host_sessions[i];
+    memset(session, 0, sizeof(*session));
+    session->in_fd = in_fd;
+    session->out_fd = out_fd;
+    session->is_owned = is_owned;
+    session->pty_slave_fd = -1;
+
+    if (isatty(in_fd) && !tcgetattr(in_fd, &session->saved_tio))
+    {
+        struct termios tio = session->saved_tio;
+
+        cfmakeraw(&tio);
+        tcsetattr(in_fd, TCSANOW, &tio);
+        session->is_tty = 1;
+    }
+
+    session->cli.transport = session;
+    session->cli.EnableUartInt = CliHostKick;
+    session->cli.DisableUartInt = CliHostNop;
+#if CLI_CFG_MACROS
+    session->cli.StoreMacros = CliStoreMacros;
+    session->cli.LoadMacros = CliLoadMacros;
+#endif
+
+    if (CliHostWatch(in_fd, i))
+    {
+        session->in_fd = -1;
+        return -1;
+    }
+
+    if (CliAddSession(&session->cli))
+    {
+        session->is_owned = 0;  // the caller closes them
+        CliHostClose(session);
+        return -1;
+    }
+
+    return 0;
+}
+
+int CliHostOpen(int in_fd, int out_fd)
+{
+    return CliHostAdd(in_fd, out_fd, 0);
+}
+
+int CliHostOpenPty(char *name, unsigned len)
+{
+    int fd = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    int slave_fd = -1;
+    struct termios tio;
+
+    if (fd < 0 || grantpt(fd) || unlockpt(fd) || ptsname_r(fd, name, len)
+        || (slave_fd = open(name, O_RDWR | O_NOCTTY | O_CLOEXEC)) < 0)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    /* raw, or the line discipline echoes our output back as input */
+    if (!tcgetattr(slave_fd, &tio))
+    {
+        cfmakeraw(&tio);
+        tcsetattr(slave_fd, TCSANOW, &tio);
+    }
+
+    if (CliHostAdd(fd, fd, 1))
+    {
+        close(slave_fd);
+        close(fd);
+        return -1;
+    }
+
+    for (unsigned i = 0; i < CLI_MAX_SESSIONS; ++i)
+    {
+        if (host_sessions[i].in_fd == fd)
+        {
+            host_sessions[i].pty_slave_fd = slave_fd;
+        }
+    }
+
+    return 0;
+}
+
+static int CliHostListen(int fd, const struct sockaddr *addr, socklen_t len)
+{
+    unsigned i = 0;
+
+    for (i = 0; i < CLI_HOST_MAX_LISTENERS && listen_fds[i] >= 0; ++i);
+
+    if (fd < 0 || i == CLI_HOST_MAX_LISTENERS || bind(fd, addr, len) || listen(fd, 8)
+        || CliHostWatch(fd, EV_LISTENER(i)))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    listen_fds[i] = fd;
+
+    return 0;
+}
+
+int CliHostListenUnix(const char *path)
+{
+    struct sockaddr_un addr = { 0 };
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        return -1;
+    }
+
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);  // left over from a previous run
+
+    return CliHostListen(socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), (struct sockaddr*)&addr, sizeof(addr));
+}
+
+int CliHostListenTcp(unsigned short port)
+{
+    struct sockaddr_in addr = { 0 };
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (fd >= 0)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+
+    return CliHostListen(fd, (struct sockaddr*)&addr, sizeof(addr));
+}
+
+static void CliHostAccept(int listen_fd)
+{
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    int one = 1;
+
+    if (fd >= 0)
+    {
+        /* echo goes out a few bytes at a time, don't let Nagle hold it (fails quietly on Unix sockets) */
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    if (fd >= 0 && CliHostAdd(fd, fd, 1))
+    {
+        static const char busy[] = "too many sessions\r\n";
+
+        if (write(fd, busy, sizeof(busy) - 1) < 0)
+        {
+            // closing anyway
+        }
+        close(fd);
+    }
+}
+
+static void CliHostRead(tCliHostSession *session)
+{
+    char in[LEN_HOST_IO];
+    ssize_t len = read(session->in_fd, in, sizeof(in));
+
+    if (len < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return;
+    }
+
+    if (len <= 0)
+    {
+        session->is_dead = 1;
+        return;
+    }
+
+    for (ssize_t i = 0; i < len && !session->is_dead; ++i)
+    {
+        CliRxChar(&session->cli, in[i]);
+
+        if (session->cli.was_input_received)
+        {
+            CliHandleSession(&session->cli);  // before the next byte, so nothing typed ahead is lost
+        }
+    }
+}
+
+int CliHostPoll(int timeout_ms)
+{
+    struct epoll_event events[CLI_HOST_MAX_EVENTS];
+    int num_events = epoll_wait(epoll_fd, events, CLI_HOST_MAX_EVENTS, timeout_ms);
+    int num_sessions = 0;
+
+    for (int i = 0; i < num_events; ++i)
+    {
+        unsigned id = events[i].data.u32;
+
+        if (id >= EV_LISTENER(0))
+        {
+            CliHostAccept(listen_fds[id - EV_LISTENER(0)]);
+        }
+        else if (host_sessions[id].in_fd >= 0)
+        {
+            CliHostRead(&host_sessions[id]);
+        }
+    }
+
+    for (unsigned i = 0; i < CLI_MAX_SESSIONS; ++i)
+    {
+        if (host_sessions[i].in_fd >= 0 && host_sessions[i].is_dead)
+        {
+            CliHostClose(&host_sessions[i]);
+        }
+
+        num_sessions += host_sessions[i].in_fd >= 0;
+    }
+
+    return num_sessions;
+}
+
+#endif /* CLI_CFG_HOST */
@@ -0,0 +1,227 @@
+/*
+ * cli_lz.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* LZ coded output, "compress on" / "compress off".
+ *
+ * The Tx ISR codes the queued text as it sends it, one token at a time, matching it against
+ * the last LEN_LZ_WINDOW bytes sent. Tokens are whole bytes, so the host can decode as they come:
+ *     0x00-0x7F           the ASCII byte itself
+ *     0x80-0xFE offset    (b - 0x80 + 3) bytes from (offset + 1) bytes back in the text
+ *     0xFF byte           a byte of 0x80 and above
+ *     0xFF 0x00           end, plain text follows
+ * Matches may run on into the strings queued after the current one, never wait for more.
+ *
+ * "compress on" answers "compress: lz <LEN_LZ_WINDOW>\r\n" in plain text, everything after
+ * that is coded. tools/cli_lzterm.py does the handshake and decodes.
+ */
+
+#include "cli.h"
+
+#if CLI_CFG_COMPRESS
+
+#define LZ_MATCH 0x80
+#define LZ_ESCAPE 0xFF
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_ESCAPE - LZ_MATCH - 1 + LZ_MIN_MATCH)
+#define LZ_MAX_TRIES 8          // candidates CliLzMatch compares for one token
+#define LZ_GOOD_MATCH 16        // long enough to stop looking for a longer one
+
+static void CliLzAppend(unsigned char c)
+{
+    p_cli->lz_window[p_cli->lz_win_pos] = c;
+    p_cli->lz_win_pos = (p_cli->lz_win_pos + 1) % LEN_LZ_WINDOW;
+    if (p_cli->lz_win_len < LEN_LZ_WINDOW)
+    {
+        p_cli->lz_win_len++;
+    }
+}
+
+/* Next byte still to send at cur, looking on into the queued strings, -1 past the last one */
+static int CliLzNext(const char **cur, unsigned char *slot)
+{
+    while (!**cur)
+    {
+        if (*slot == p_cli->out_head)
+        {
+            return -1;
+        }
+
+        *cur = p_cli->output_buffer[*slot];
+        *slot = (*slot + 1) % NUM_OUT_MSG_QUEUE;
+    }
+
+    return (unsigned char)*(*cur)++;
+}
+
+/* Longest match of what's to send in the window, not overlapping what it copies. It runs in the
+ * Tx ISR, so it gives up after LZ_MAX_TRIES candidates and takes the first of LZ_GOOD_MATCH bytes.
+ * Oldest first, those have the most room before the overlap */
+static unsigned CliLzMatch(const char *text, unsigned *offset)
+{
+    unsigned best = 0;
+    unsigned tries = 0;
+
+    for (unsigned off = p_cli->lz_win_len; off && tries < LZ_MAX_TRIES && best < LZ_GOOD_MATCH; --off)
+    {
+        unsigned start = (p_cli->lz_win_pos + LEN_LZ_WINDOW - off) % LEN_LZ_WINDOW;
+        const char *cur = text;
+        unsigned char slot = p_cli->out_tail;
+        unsigned len = 0;
+
+        if (p_cli->lz_window[start] != (unsigned char)*text)
+        {
+            continue;
+        }
+
+        ++tries;
+        while (len < off && len < LZ_MAX_MATCH
+               && p_cli->lz_window[(start + len) % LEN_LZ_WINDOW] == CliLzNext(&cur, &slot))
+        {
+            ++len;
+        }
+
+        if (len > best)
+        {
+            best = len;
+            *offset = off;
+        }
+    }
+
+    return best;
+}
+
+int CliLzTxByte(const char *text, char *c)
+{
+    unsigned len = 0;
+    unsigned offset = 0;
+
+    if (!p_cli->lz_num_pending)
+    {
+        if (!text || !p_cli->lz_is_on)
+        {
+            return 0;
+        }
+
+        len = CliLzMatch(text, &offset);
+        if (len >= LZ_MIN_MATCH)
+        {
+            p_cli->lz_pending[0] = LZ_MATCH + len - LZ_MIN_MATCH;
+            p_cli->lz_pending[1] = offset - 1;
+            p_cli->lz_num_pending = 2;
+        }
+        else
+        {
+            len = 1;
+            p_cli->lz_pending[0] = LZ_ESCAPE;
+            p_cli->lz_pending[1] = *text;
+            p_cli->lz_num_pending = (unsigned char)*text < LZ_MATCH ? 1 : 2;
+        }
+
+        for (unsigned i = 0; i < len; ++i, text = CliTxText())
+        {
+            CliLzAppend(*text);
+            p_cli->tx_char_idx++;
+        }
+        p_cli->lz_bytes_in += len;
+    }
+
+    *c = p_cli->lz_pending[2 - p_cli->lz_num_pending--];
+    p_cli->lz_bytes_out++;
+
+    return 1;
+}
+
+static void CliLzSendRatio(unsigned long num, unsigned long den)
+{
+    unsigned long hundredths = den ? num * 100 / den : 0;
+
+    CliSendString(CliAllocNum(hundredths / 100, 10));
+    CliSendString(hundredths % 100 < 10 ? ".0" : ".");
+    CliSendString(CliAllocNum(hundredths % 100, 10));
+}
+
+int CliCompressCmd(char *args)
+{
+    if (args && !strcmp(args, "on"))
+    {
+        if (p_cli->lz_is_on)
+        {
+            return 0;
+        }
+
+        CliSendString("compress: lz ");
+        CliSendString(CliAllocNum(LEN_LZ_WINDOW, 10));
+        CliSendString("\r\n");
+        if (CliFlush())
+        {
+            return -1;
+        }
+
+        p_cli->lz_win_pos = 0;
+        p_cli->lz_win_len = 0;
+        p_cli->lz_bytes_in = 0;
+        p_cli->lz_bytes_out = 0;
+        p_cli->lz_is_on = 1;  // the queue is empty and keys are dropped while this runs, so the prompt is the first coded text
+        return 0;
+    }
+
+    if (args && !strcmp(args, "off"))
+    {
+        if (!p_cli->lz_is_on || CliFlush())
+        {
+            return p_cli->lz_is_on ? -1 : 0;
+        }
+
+        p_cli->lz_pending[0] = LZ_ESCAPE;
+        p_cli->lz_pending[1] = 0;
+        p_cli->lz_num_pending = 2;  // the end marker goes out before anything queued from now on
+        p_cli->lz_is_on = 0;
+        return 0;
+    }
+
+    if (args && *args)
+    {
+        CliSendString("compress [on | off]");
+        return -1;
+    }
+
+    /* "compress: on, 1200 B in, 480 B out, ratio 2.50, throughput +150%" */
+    CliSendString(p_cli->lz_is_on ? "compress: on, " : "compress: off, ");
+    CliSendString(CliAllocNum(p_cli->lz_bytes_in, 10));
+    CliSendString(" B in, ");
+    CliSendString(CliAllocNum(p_cli->lz_bytes_out, 10));
+    CliSendString(" B out, ratio ");
+    CliLzSendRatio(p_cli->lz_bytes_in, p_cli->lz_bytes_out);
+    CliSendString(", throughput +");
+    CliSendString(CliAllocNum(p_cli->lz_bytes_out && p_cli->lz_bytes_in > p_cli->lz_bytes_out ?
+                              (p_cli->lz_bytes_in - p_cli->lz_bytes_out) * 100 / p_cli->lz_bytes_out : 0, 10));
+    CliSendString("%");
+
+    return 0;
+}
+
+#endif /* CLI_CFG_COMPRESS */
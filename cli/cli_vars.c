@@ -0,0 +1,464 @@
+/*
+ * cli_vars.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "cli.h"
+#include <errno.h>
+#include <float.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#if CLI_CFG_VARS
+
+#define NUM_SNAPSHOT_VARS 16
+#define LEN_HEX_PIECE ((LEN_ARENA - 1) / 2)  // snapshot bytes per arena allocation with -x, 2 hex digits each
+
+static const unsigned char type_sizes[] = { 1, 2, 4, 1, 2, 4, 4 }; // in eCLI_VAR_xxx order
+
+static unsigned char snapshot[LEN_SNAPSHOT] = { 0 };
+
+typedef union
+{
+    uint8_t u8;
+    uint16_t u16;
+    uint32_t u32;
+    int8_t s8;
+    int16_t s16;
+    int32_t s32;
+    float f;
+} tVarValue;   // packed data may be misaligned, so elements are copied in and out of this
+
+static int num_vars = -1;  // counted on first use
+
+static char* CliVarNum(unsigned long value)
+{
+    char *text = CliAlloc(12);
+
+    return text ? CliUtoa(value, text, 10) : NULL;
+}
+
+const tCliVar* CliFindVar(const char *name, unsigned len)
+{
+    unsigned lo = 0;
+    unsigned hi = 0;
+    int cmp = 0;
+
+    if (num_vars < 0)
+    {
+        for (num_vars = 0; cli_vars[num_vars].name[0]; ++num_vars);
+    }
+
+    hi = num_vars;
+
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+
+        cmp = strncmp(cli_vars[mid].name, name, len);
+        if (!cmp)
+        {
+            cmp = cli_vars[mid].name[len] ? 1 : 0;
+        }
+
+        if (!cmp)
+        {
+            return &cli_vars[mid];
+        }
+        else if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    return NULL;
+}
+
+unsigned CliVarSize(const tCliVar *var)
+{
+    return type_sizes[var->type] * var->count;
+}
+
+/* 3 decimals, no printf. Past what an unsigned long holds on the target it switches to d.ddde<n>,
+ * so every float fits in 18 chars */
+static void CliFormatFloat(float f_value, char *digits)
+{
+    unsigned long whole = 0;
+    unsigned long fraction = 0;
+    unsigned exponent = 0;
+    char is_negative = f_value < 0;
+
+    if (f_value != f_value)
+    {
+        strcpy(digits, "nan");
+        return;
+    }
+
+    f_value = is_negative ? -f_value : f_value;
+    if (f_value > FLT_MAX)
+    {
+        strcpy(digits, is_negative ? "-inf" : "inf");
+        return;
+    }
+
+    if (f_value >= 4294967296.0f)
+    {
+        for (exponent = 0; f_value >= 10; ++exponent)
+        {
+            f_value /= 10;
+        }
+    }
+
+    whole = (unsigned long)f_value;
+    fraction = (unsigned long)((f_value - whole) * 1000 + 0.5f);
+    if (fraction >= 1000)
+    {
+        fraction -= 1000;
+        ++whole;  // below 2^32 a float with a fraction is small enough for this
+    }
+    if (exponent && whole >= 10)
+    {
+        whole /= 10;
+        ++exponent;
+    }
+
+    if (is_negative && (whole || fraction))
+    {
+        *digits++ = '-';  // no "-0.000"
+    }
+
+    CliUtoa(whole, digits, 10);
+    digits += strlen(digits);
+    *digits++ = '.';
+    *digits++ = '0' + fraction / 100;
+    *digits++ = '0' + fraction / 10 % 10;
+    *digits++ = '0' + fraction % 10;
+    *digits = 0;
+
+    if (exponent)
+    {
+        *digits++ = 'e';
+        CliUtoa(exponent, digits, 10);
+    }
+}
+
+/* Formats element idx of a copy of var's data */
+static char* CliFormatValue(const tCliVar *var, const unsigned char *data, unsigned idx)
+{
+    char *text = CliAlloc(24);
+    char *digits = text;
+    long value = 0;
+    tVarValue element;
+
+    if (!text)
+    {
+        return "...";
+    }
+
+    memcpy(&element, data + idx * type_sizes[var->type], type_sizes[var->type]);
+
+    switch (var->type)
+    {
+        case eCLI_VAR_U8:
+            value = element.u8;
+            break;
+        case eCLI_VAR_U16:
+            value = element.u16;
+            break;
+        case eCLI_VAR_U32:
+            CliUtoa(element.u32, text, 10);
+            return text;
+        case eCLI_VAR_S8:
+            value = element.s8;
+            break;
+        case eCLI_VAR_S16:
+            value = element.s16;
+            break;
+        case eCLI_VAR_S32:
+            value = element.s32;
+            break;
+        case eCLI_VAR_FLOAT:
+            CliFormatFloat(element.f, digits);
+            return text;
+        default:
+            return "?";
+    }
+
+    if (value < 0)
+    {
+        *digits++ = '-';
+        CliUtoa(0 - (unsigned long)value, digits, 10);  // -INT32_MIN doesn't fit a 32 bit long
+        return text;
+    }
+
+    CliUtoa(value, digits, 10);
+
+    return text;
+}
+
+static void CliSendVar(const tCliVar *var, const unsigned char *data)
+{
+    CliSendString(var->name);
+    CliSendString(" =");
+
+    for (unsigned i = 0; i < var->count; ++i)
+    {
+        CliSendString(" ");
+        CliSendString(CliFormatValue(var, data, i));
+    }
+
+    if (var->unit && var->unit[0])
+    {
+        CliSendString(" ");
+        CliSendString(var->unit);
+    }
+
+    CliSendString("\r\n");
+}
+
+int CliGetCmd(char *args)
+{
+    const tCliVar *var = NULL;
+    unsigned primask = 0;
+
+    if (!args || !args[0])
+    {
+        /* list the registry */
+        for (unsigned i = 0; cli_vars[i].name[0]; ++i)
+        {
+            CliSendString(cli_vars[i].name);
+            CliSendString(cli_vars[i].access & CLI_VAR_WR ? " rw " : " r ");
+            CliSendString(CliVarNum(CliVarSize(&cli_vars[i])));
+            CliSendString("B\r\n");
+        }
+
+        return 0;
+    }
+
+    var = CliFindVar(args, strcspn(args, " \t"));
+
+    if (!var || !(var->access & CLI_VAR_RD) || CliVarSize(var) > LEN_SNAPSHOT)
+    {
+        CliSendString("get: no such readable var");
+        return -1;
+    }
+
+    primask = CliEnterCritical();
+    memcpy(snapshot, var->addr, CliVarSize(var));
+    CliExitCritical(primask);
+
+    CliSendVar(var, snapshot);
+
+    return 0;
+}
+
+int CliSetCmd(char *args)
+{
+    const tCliVar *var = NULL;
+    unsigned len = strcspn(args, " \t");
+    unsigned num = 0;
+    unsigned primask = 0;
+    char *arg_end = NULL;
+
+    var = CliFindVar(args, len);
+
+    if (!var || !(var->access & CLI_VAR_WR) || CliVarSize(var) > LEN_SNAPSHOT)
+    {
+        CliSendString("set: no such writable var");
+        return -1;
+    }
+
+    args += len;
+
+    /* parse all elements into snapshot first, so that a bad value changes nothing. Commands run one
+     * at a time, get and snapshot aren't using it now */
+    for (unsigned i = 0; i < var->count; ++i)
+    {
+        tVarValue element;
+        unsigned long u = 0;
+        long s = 0;
+        int is_bad = 0;
+
+        while (*args == ' ' || *args == '\t')
+        {
+            ++args;
+        }
+
+        errno = 0;
+        switch (var->type)
+        {
+            case eCLI_VAR_U8:
+                u = strtoul(args, &arg_end, 0);
+                is_bad = *args == '-' || u > UINT8_MAX;
+                element.u8 = u;
+                break;
+            case eCLI_VAR_U16:
+                u = strtoul(args, &arg_end, 0);
+                is_bad = *args == '-' || u > UINT16_MAX;
+                element.u16 = u;
+                break;
+            case eCLI_VAR_U32:
+                u = strtoul(args, &arg_end, 0);
+                is_bad = *args == '-' || u > UINT32_MAX;
+                element.u32 = u;
+                break;
+            case eCLI_VAR_S8:
+                s = strtol(args, &arg_end, 0);
+                is_bad = s < INT8_MIN || s > INT8_MAX;
+                element.s8 = s;
+                break;
+            case eCLI_VAR_S16:
+                s = strtol(args, &arg_end, 0);
+                is_bad = s < INT16_MIN || s > INT16_MAX;
+                element.s16 = s;
+                break;
+            case eCLI_VAR_S32:
+                s = strtol(args, &arg_end, 0);
+                is_bad = s < INT32_MIN || s > INT32_MAX;
+                element.s32 = s;
+                break;
+            case eCLI_VAR_FLOAT:
+                element.f = strtof(args, &arg_end);
+                break;
+            default:
+                arg_end = args;
+                break;
+        }
+
+        if (arg_end == args || is_bad || errno == ERANGE || (*arg_end && *arg_end != ' ' && *arg_end != '\t'))
+        {
+            break;  // not a number, out of the type's range or with junk attached
+        }
+
+        memcpy(&snapshot[i * type_sizes[var->type]], &element, type_sizes[var->type]);
+        args = arg_end;
+        num = i + 1;
+    }
+
+    while (*args == ' ' || *args == '\t')
+    {
+        ++args;
+    }
+
+    if (num != var->count || *args)
+    {
+        CliSendString("set: expected ");
+        CliSendString(CliVarNum(var->count));
+        CliSendString(" value(s)");
+        return -1;
+    }
+
+    primask = CliEnterCritical();
+    memcpy(var->addr, snapshot, CliVarSize(var));
+    CliExitCritical(primask);
+
+    return 0;
+}
+
+int CliSnapshotCmd(char *args)
+{
+    static const char hex_digits[] = "0123456789ABCDEF";
+    const tCliVar *vars[NUM_SNAPSHOT_VARS] = { 0 };
+    unsigned num = 0;
+    unsigned len = 0;
+    unsigned size = 0;
+    unsigned primask = 0;
+    char is_hex = 0;
+    char *text = NULL;
+
+    if (!strncmp(args, "-x", 2) && (args[2] == ' ' || !args[2]))
+    {
+        is_hex = 1;
+        args += 2;
+    }
+
+    /* resolve all names before touching any data */
+    for (;;)
+    {
+        args += strspn(args, " \t");
+        len = strcspn(args, " \t");
+
+        if (!len)
+        {
+            break;
+        }
+
+        if (num >= NUM_SNAPSHOT_VARS || !(vars[num] = CliFindVar(args, len))
+                || !(vars[num]->access & CLI_VAR_RD) || size + CliVarSize(vars[num]) > LEN_SNAPSHOT)
+        {
+            CliSendString("snapshot: bad var or too many bytes");
+            return -1;
+        }
+
+        size += CliVarSize(vars[num++]);
+        args += len;
+    }
+
+    /* one consistent copy of everything */
+    primask = CliEnterCritical();
+    for (unsigned i = 0, offset = 0; i < num; offset += CliVarSize(vars[i++]))
+    {
+        memcpy(&snapshot[offset], vars[i]->addr, CliVarSize(vars[i]));
+    }
+    CliExitCritical(primask);
+
+    if (is_hex)
+    {
+        /* raw bytes in request order, one line for all values, sent in pieces that fit the arena */
+        CliSendString(":");
+        for (unsigned i = 0, len = 0; i < size; i += len)
+        {
+            len = size - i < LEN_HEX_PIECE ? size - i : LEN_HEX_PIECE;
+            if (!(text = CliAlloc(2 * len + 1)))
+            {
+                return -1;
+            }
+
+            for (unsigned j = 0; j < len; ++j)
+            {
+                text[2 * j] = hex_digits[snapshot[i + j] >> 4];
+                text[2 * j + 1] = hex_digits[snapshot[i + j] & 0xF];
+            }
+            text[2 * len] = 0;
+
+            CliSendString(text);
+        }
+
+        return 0;
+    }
+
+    for (unsigned i = 0, offset = 0; i < num; offset += CliVarSize(vars[i++]))
+    {
+        CliSendVar(vars[i], &snapshot[offset]);
+    }
+
+    return 0;
+}
+
+#endif /* CLI_CFG_VARS */
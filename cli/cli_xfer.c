@@ -0,0 +1,598 @@
+/*
+ * cli_xfer.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* Bulk binary transfers, "load <addr>" and "save <addr> <len>".
+ *
+ * Blocks are framed like XMODEM-CRC: SOH seq ~seq <LEN_XFER_BLOCK bytes> crc_hi crc_lo.
+ * Block 0 is a YMODEM-like header holding the image length in ASCII decimal, data follows
+ * from block 1 on, and EOT ends the transfer. Unlike XMODEM, the receiver answers every block
+ * with ACK/NAK followed by a seq byte, so the sender may keep a window of blocks in flight
+ * (go-back-N: NAK <seq> means "resend from seq"). Lost blocks are the host's to time out: it
+ * sends NAK <expected seq> or resends from its window base (the device drops a partial block
+ * after XFER_RESYNC_MS of silence). Blocks ahead of a missing one are dropped silently, so one
+ * lost block costs one NAK and one window resend. CAN CAN (Ctrl-X twice in a terminal) aborts,
+ * and the device gives up by itself after CLI_XFER_TIMEOUT_MS without a byte from the host,
+ * e.g. when "load" was typed by mistake or the host died.
+ *
+ * While a transfer is active, CliRxISR hands every byte to CliXferRxByte (no line editing) and
+ * CliTxISR only sends transfer bytes, text queued meanwhile goes out afterwards. The command
+ * waits in its callback until the transfer ends, so lines of other sessions are only run
+ * after that (their echo and editing keep working from the ISRs). Only one session can
+ * transfer at a time.
+ */
+
+#include "cli.h"
+#include <stdlib.h>
+
+#if CLI_CFG_XFER
+
+#define XFER_SOH 0x01
+#define XFER_STX 0x02
+#define XFER_EOT 0x04
+#define XFER_ACK 0x06
+#define XFER_NAK 0x15
+#define XFER_CAN 0x18
+#define XFER_CRC_REQ 'C'
+#define XFER_PAD 0x1A
+
+#if LEN_XFER_BLOCK == 1024
+#define XFER_HDR XFER_STX
+#else
+#define XFER_HDR XFER_SOH
+#endif
+
+#define LEN_XFER_CTRL 8  // queued ACK/NAK/CAN bytes
+#define XFER_RESYNC_MS 100  // a gap this long inside a block means bytes were lost, start over
+
+static const unsigned short crc_nibbles[16] =
+{
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static struct
+{
+    volatile enum
+    {
+        eXFER_IDLE, eXFER_LOAD, eXFER_SAVE
+    } mode;
+    enum
+    {
+        eBLK_HDR, eBLK_SEQ, eBLK_NSEQ, eBLK_DATA, eBLK_CRC_HI, eBLK_CRC_LO, eBLK_ACK_SEQ
+    } rx_state;
+
+    tCli *p_session;            // only this session's bytes are transfer bytes
+    const tCliSink *sink;
+    unsigned long addr;
+    unsigned long len;          // image length, from block 0 on load
+    unsigned long block;        // load: next block expected, save: next block to send
+    unsigned long base;         // save: oldest block not acked
+    unsigned long num_blocks;   // save: header + data blocks
+    unsigned long retries;
+    unsigned long t_start;
+    volatile unsigned long t_last_rx;  // also read by the waiting callback
+    int error;
+
+    /* Rx side of the current block */
+    unsigned char seq;
+    unsigned char rx_cmd;
+    unsigned char *dst;
+    unsigned data_idx;
+    unsigned short crc;
+    unsigned short rx_crc;
+
+    /* Tx side */
+    unsigned char ctrl[LEN_XFER_CTRL];
+    unsigned ctrl_head;
+    unsigned ctrl_tail;
+    char is_nak_sent;           // load: NAK once per missing block, the host's timeout covers the rest
+    char is_can_recvd;
+    char is_sending;            // save: inside a frame
+    char is_eot_sent;
+    unsigned tx_idx;
+    unsigned long tx_block;
+    const unsigned char *tx_data;
+    unsigned short tx_crc;
+} xfer;
+
+static unsigned char block_buff[LEN_XFER_BLOCK];  // header block, or staging for sinks without GetBuffer
+
+static unsigned char* CliRamGetBuffer(unsigned long addr, unsigned len)
+{
+    return (unsigned char*)addr;
+}
+
+static int CliRamRead(unsigned long addr, unsigned char *data, unsigned len)
+{
+    memcpy(data, (const void*)addr, len);
+    return 0;
+}
+
+const tCliSink cli_ram_sink = { CliRamGetBuffer, 0, CliRamRead };
+
+static unsigned short CliCrc16(unsigned short crc, unsigned char c)
+{
+    crc = (crc << 4) ^ crc_nibbles[((crc >> 12) ^ (c >> 4)) & 0x0F];
+    crc = (crc << 4) ^ crc_nibbles[((crc >> 12) ^ (c & 0x0F)) & 0x0F];
+
+    return crc;
+}
+
+static void CliXferPut(unsigned char c)
+{
+    xfer.ctrl[xfer.ctrl_head++ % LEN_XFER_CTRL] = c;
+    p_cli->EnableUartInt();
+}
+
+static void CliXferCtrl(unsigned char c, unsigned char seq)
+{
+    xfer.ctrl[xfer.ctrl_head++ % LEN_XFER_CTRL] = c;
+    CliXferPut(seq);
+}
+
+static void CliXferEnd(int error)
+{
+    xfer.error = error;
+
+    if (error)
+    {
+        CliXferCtrl(XFER_CAN, XFER_CAN);
+    }
+
+    xfer.mode = eXFER_IDLE;
+}
+
+int CliXferIsActive(void)  // for p_cli
+{
+    return (xfer.mode != eXFER_IDLE || xfer.ctrl_tail != xfer.ctrl_head) && xfer.p_session == p_cli;
+}
+
+/* Load: block payload goes straight to the target (RAM) or to block_buff (other sinks) */
+static void CliXferStartBlock(void)
+{
+    unsigned long offset = 0;
+
+    xfer.dst = block_buff;
+
+    if (xfer.seq == (unsigned char)xfer.block && xfer.block && xfer.sink->GetBuffer)
+    {
+        offset = (xfer.block - 1) * LEN_XFER_BLOCK;
+        if (offset + LEN_XFER_BLOCK <= xfer.len)
+        {
+            xfer.dst = xfer.sink->GetBuffer(xfer.addr + offset, LEN_XFER_BLOCK);
+        }
+    }
+}
+
+static void CliXferEndBlock(void)
+{
+    unsigned long offset = 0;
+    unsigned len = LEN_XFER_BLOCK;
+
+    if (xfer.crc != xfer.rx_crc || xfer.seq != (unsigned char)~xfer.rx_cmd || xfer.seq != (unsigned char)xfer.block)
+    {
+        if (xfer.crc == xfer.rx_crc && xfer.seq == (unsigned char)(xfer.block - 1))
+        {
+            CliXferCtrl(XFER_ACK, xfer.seq);  // our ACK got lost
+        }
+        else if (!xfer.is_nak_sent)
+        {
+            xfer.retries++;
+            xfer.is_nak_sent = 1;
+            CliXferCtrl(XFER_NAK, xfer.block);
+        }
+        return;
+    }
+
+    xfer.is_nak_sent = 0;
+
+    if (!xfer.block)
+    {
+        xfer.len = strtoul((const char*)block_buff, 0, 10);
+    }
+    else
+    {
+        offset = (xfer.block - 1) * LEN_XFER_BLOCK;
+        if (offset >= xfer.len)
+        {
+            CliXferEnd(-1);  // more blocks than announced
+            return;
+        }
+
+        if (offset + len > xfer.len)
+        {
+            len = xfer.len - offset;
+        }
+
+        if (xfer.dst == block_buff)
+        {
+            if (xfer.sink->GetBuffer)
+            {
+                memcpy(xfer.sink->GetBuffer(xfer.addr + offset, len), block_buff, len);  // partial last block
+            }
+            else if (xfer.sink->Write(xfer.addr + offset, block_buff, len))
+            {
+                CliXferEnd(-2);
+                return;
+            }
+        }
+    }
+
+    CliXferCtrl(XFER_ACK, xfer.block++);
+}
+
+/* Save: next byte of the frame being sent */
+static unsigned char CliXferFrameByte(void)
+{
+    unsigned long offset = 0;
+    unsigned char c = 0;
+
+    if (xfer.tx_idx == 0)
+    {
+        xfer.tx_block = xfer.block++;
+        xfer.tx_crc = 0;
+        xfer.tx_data = block_buff;
+
+        if (!xfer.tx_block)
+        {
+            memset(block_buff, 0, LEN_XFER_BLOCK);
+            CliUtoa(xfer.len, (char*)block_buff, 10);
+        }
+        else
+        {
+            offset = (xfer.tx_block - 1) * LEN_XFER_BLOCK;
+            if (xfer.sink->GetBuffer)
+            {
+                xfer.tx_data = xfer.sink->GetBuffer(xfer.addr + offset, LEN_XFER_BLOCK);
+            }
+            else if (xfer.sink->Read(xfer.addr + offset, block_buff,
+                    xfer.len - offset < LEN_XFER_BLOCK ? xfer.len - offset : LEN_XFER_BLOCK))
+            {
+                CliXferEnd(-2);
+                return XFER_CAN;
+            }
+        }
+    }
+
+    if (xfer.tx_idx == 0)
+    {
+        c = XFER_HDR;
+    }
+    else if (xfer.tx_idx == 1)
+    {
+        c = xfer.tx_block;
+    }
+    else if (xfer.tx_idx == 2)
+    {
+        c = ~xfer.tx_block;
+    }
+    else if (xfer.tx_idx < LEN_XFER_BLOCK + 3)
+    {
+        offset = xfer.tx_idx - 3;
+
+        if (xfer.tx_block && (xfer.tx_block - 1) * LEN_XFER_BLOCK + offset >= xfer.len)
+        {
+            c = XFER_PAD;
+        }
+        else
+        {
+            c = xfer.tx_data[offset];
+        }
+
+        xfer.tx_crc = CliCrc16(xfer.tx_crc, c);
+    }
+    else if (xfer.tx_idx == LEN_XFER_BLOCK + 3)
+    {
+        c = xfer.tx_crc >> 8;
+    }
+    else
+    {
+        c = xfer.tx_crc;
+        xfer.tx_idx = 0;
+        xfer.is_sending = 0;
+        return c;
+    }
+
+    xfer.tx_idx++;
+
+    return c;
+}
+
+int CliXferTxByte(char *c)
+{
+    if (xfer.ctrl_tail != xfer.ctrl_head)
+    {
+        *c = xfer.ctrl[xfer.ctrl_tail++ % LEN_XFER_CTRL];
+        return 1;
+    }
+
+    if (xfer.mode != eXFER_SAVE || !xfer.t_start)
+    {
+        return 0;
+    }
+
+    if (!xfer.is_sending && xfer.block < xfer.num_blocks && xfer.block < xfer.base + CLI_XFER_WINDOW)
+    {
+        xfer.is_sending = 1;
+    }
+
+    if (xfer.is_sending)
+    {
+        *c = CliXferFrameByte();
+        return 1;
+    }
+
+    if (xfer.base == xfer.num_blocks && !xfer.is_eot_sent)
+    {
+        xfer.is_eot_sent = 1;
+        *c = XFER_EOT;
+        return 1;
+    }
+
+    return 0;
+}
+
+void CliXferRxByte(char rec_char)
+{
+    unsigned char c = rec_char;
+    unsigned long block = 0;
+    unsigned long t_now = CliGetTickMs();
+
+    if (t_now - xfer.t_last_rx > XFER_RESYNC_MS)
+    {
+        xfer.rx_state = eBLK_HDR;
+    }
+    xfer.t_last_rx = t_now;
+
+    switch (xfer.rx_state)
+    {
+        case eBLK_HDR:
+            if (c == XFER_CAN && xfer.is_can_recvd)
+            {
+                CliXferEnd(-3);
+            }
+            xfer.is_can_recvd = (c == XFER_CAN);
+
+            if (xfer.mode == eXFER_LOAD && c == XFER_HDR)
+            {
+                xfer.rx_state = eBLK_SEQ;
+            }
+            else if (xfer.mode == eXFER_LOAD && c == XFER_EOT && xfer.block && (xfer.block - 1) * LEN_XFER_BLOCK >= xfer.len)
+            {
+                CliXferCtrl(XFER_ACK, 0);
+                CliXferEnd(0);
+            }
+            else if (xfer.mode == eXFER_SAVE && c == XFER_CRC_REQ && !xfer.t_start)
+            {
+                xfer.t_start = CliGetTickMs() | 1;  // receiver is ready
+                p_cli->EnableUartInt();
+            }
+            else if (xfer.mode == eXFER_SAVE && (c == XFER_ACK || c == XFER_NAK))
+            {
+                xfer.rx_cmd = c;
+                xfer.rx_state = eBLK_ACK_SEQ;
+            }
+            break;
+        case eBLK_SEQ:
+            xfer.seq = c;
+            xfer.rx_state = eBLK_NSEQ;
+            break;
+        case eBLK_NSEQ:
+            xfer.rx_cmd = c;  // ~seq, checked with the CRC
+            xfer.crc = 0;
+            xfer.data_idx = 0;
+            CliXferStartBlock();
+            xfer.rx_state = eBLK_DATA;
+            break;
+        case eBLK_DATA:
+            xfer.dst[xfer.data_idx] = c;
+            xfer.crc = CliCrc16(xfer.crc, c);
+            if (++xfer.data_idx == LEN_XFER_BLOCK)
+            {
+                xfer.rx_state = eBLK_CRC_HI;
+            }
+            break;
+        case eBLK_CRC_HI:
+            xfer.rx_crc = c << 8;
+            xfer.rx_state = eBLK_CRC_LO;
+            break;
+        case eBLK_CRC_LO:
+            xfer.rx_crc |= c;
+            xfer.rx_state = eBLK_HDR;
+            CliXferEndBlock();
+            break;
+        case eBLK_ACK_SEQ:
+            xfer.rx_state = eBLK_HDR;
+
+            if (xfer.is_eot_sent)
+            {
+                if (xfer.rx_cmd == XFER_ACK)
+                {
+                    CliXferEnd(0);
+                }
+                else
+                {
+                    xfer.is_eot_sent = 0;  // send it again
+                    p_cli->EnableUartInt();
+                }
+                break;
+            }
+
+            /* seq -> block, within what was sent */
+            block = xfer.base + (unsigned char)(c - xfer.base);
+            if (block >= xfer.block)
+            {
+                break;
+            }
+
+            if (xfer.rx_cmd == XFER_ACK)
+            {
+                xfer.base = block + 1;
+            }
+            else
+            {
+                xfer.retries++;
+                xfer.base = block;
+                xfer.block = block;  // go back, a frame being sent keeps its own tx_block
+            }
+            p_cli->EnableUartInt();
+            break;
+        default:
+            xfer.rx_state = eBLK_HDR;
+            break;
+    }
+}
+
+static int CliXferIsBusy(void)
+{
+    if (xfer.mode != eXFER_IDLE || xfer.ctrl_tail != xfer.ctrl_head)
+    {
+        CliSendString("another session is transferring");
+        return 1;
+    }
+
+    return 0;
+}
+
+static int CliXferRun(const char *what)
+{
+    unsigned long t_ms = 0;
+    unsigned state = 0;
+
+    xfer.t_last_rx = CliGetTickMs();
+
+    while (xfer.mode != eXFER_IDLE)
+    {
+        // the ISRs do all the work, unless the host went quiet
+        t_ms = xfer.t_last_rx;  // before the tick, a byte in between must not wrap the difference
+        if (CliGetTickMs() - t_ms > CLI_XFER_TIMEOUT_MS)
+        {
+            state = CliEnterCritical();
+            if (xfer.mode != eXFER_IDLE)
+            {
+                CliXferEnd(-4);
+            }
+            CliExitCritical(state);
+        }
+    }
+
+    t_ms = CliGetTickMs() - (xfer.t_start & ~1UL);
+
+    CliSendString(what);
+
+    if (xfer.error)
+    {
+        CliSendString(xfer.error == -4 ? ": timed out" : ": aborted");
+        return -1;
+    }
+
+    /* "<what>: <n> B, <t> ms, <n> B/s, <n> retries" */
+    CliSendString(": ");
+    CliSendString(CliAllocNum(xfer.len, 10));
+    CliSendString(" B, ");
+    CliSendString(CliAllocNum(t_ms, 10));
+    CliSendString(" ms, ");
+    CliSendString(CliAllocNum(t_ms ? xfer.len * 1000 / t_ms : 0, 10));
+    CliSendString(" B/s, ");
+    CliSendString(CliAllocNum(xfer.retries, 10));
+    CliSendString(" retries");
+
+    return 0;
+}
+
+int CliLoadCmd(char *args)
+{
+    char *arg_end = NULL;
+
+    if (CliXferIsBusy())
+    {
+        return -1;
+    }
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.p_session = p_cli;
+    xfer.sink = &cli_ram_sink;
+
+    if (!strncmp(args, "-f", 2))
+    {
+        xfer.sink = &cli_flash_sink;
+        args += 2;
+    }
+
+    xfer.addr = strtoul(args, &arg_end, 0);
+    if (arg_end == args)
+    {
+        CliSendString("load [-f] <addr>");
+        return -1;
+    }
+
+    xfer.t_start = CliGetTickMs() | 1;
+    xfer.mode = eXFER_LOAD;
+    CliXferPut(XFER_CRC_REQ);
+
+    return CliXferRun("load");
+}
+
+int CliSaveCmd(char *args)
+{
+    char *arg_end = NULL;
+
+    if (CliXferIsBusy())
+    {
+        return -1;
+    }
+
+    memset(&xfer, 0, sizeof(xfer));
+    xfer.p_session = p_cli;
+    xfer.sink = &cli_ram_sink;
+
+    if (!strncmp(args, "-f", 2))
+    {
+        xfer.sink = &cli_flash_sink;
+        args += 2;
+    }
+
+    xfer.addr = strtoul(args, &arg_end, 0);
+    if (arg_end != args)
+    {
+        args = arg_end;
+        xfer.len = strtoul(args, &arg_end, 0);
+    }
+
+    if (arg_end == args || !xfer.len)
+    {
+        CliSendString("save [-f] <addr> <len>");
+        return -1;
+    }
+
+    xfer.num_blocks = 1 + (xfer.len + LEN_XFER_BLOCK - 1) / LEN_XFER_BLOCK;
+    xfer.mode = eXFER_SAVE;  // waits for 'C' from the receiver
+
+    return CliXferRun("save");
+}
+
+#endif /* CLI_CFG_XFER */
@@ -0,0 +1,390 @@
+/*
+ * cli_bench.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Per byte cost of the key decoder on the host, and the latency of line dispatch:
+ *     gcc -O2 -pthread -Icli cli/cli*.c tools/cli_bench.c -o cli_bench
+ *     ./cli_bench [runs]
+ * For every input below it times CliEscKey (the table decoder, decode only), BenchSwitchKey (the
+ * nested switch CliRxISR used before the table, decode only, same keys) and the whole
+ * CliRxChar (decode and line editing). A run goes BENCH_ROUNDS times through the input, and
+ * each figure is the best of BENCH_RUNS short runs, taken in turns, in ns per byte: a run that
+ * an interrupt or a migration hit only ever loses.
+ * Exits with 1 if the table is slower than the switch over all inputs by more than
+ * BENCH_TOLERANCE, or on any one input by more than BENCH_INPUT_TOLERANCE, so it can gate a
+ * change to tools/gen_esc_table.py. Code alignment alone moves the switch's figures by up to a
+ * quarter on a desktop core, which the total evens out. Modifiers and control keys count too: the
+ * switch has no keys for them but still reads every byte, so it's what the table replaced.
+ * Then a thread in the role of the Rx ISR types BENCH_LINES "hello" lines at random points in
+ * time, and the main loop dispatches them by polling CliPeriodicCheck every BENCH_POLL_US, or by
+ * waiting for LineReady like CliWaitForLine. The session's last_latency (CR to callback entry,
+ * see CLI_CFG_LATENCY) is listed for both, for information only.
+ */
+
+#include "cli.h"
+#include "cli_esc_table.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_RUNS 2000         // short runs, the best of them is the cost without interrupts
+#define BENCH_ROUNDS 64         // times through the input in one run, fixed
+#define BENCH_TOLERANCE 1.05    // what's left of timer and frequency noise, on the total
+#define BENCH_INPUT_TOLERANCE 1.25  // and code alignment, on one input
+#define BENCH_LINES 200         // per way of dispatching
+#define BENCH_POLL_US 1000      // main loop period when polling, e.g. a 1 ms superloop
+
+typedef struct
+{
+    const char *name;
+    const char *bytes;
+    char is_switch_key;         // the switch knows all of its keys, for the listing only
+} tBenchInput;
+
+static const tBenchInput inputs[] =
+{
+    { "text", "set led_duty 42\x15get hello_count\x15snapshot -x led_duty\x15", 1 },
+    { "arrows", "\x1b[A\x1b[B\x1b[C\x1b[D\x1bOH\x1bOF", 1 },
+    { "vt keys", "\x1b[1~\x1b[3~\x1b[4~", 1 },
+    { "modifiers", "\x1b[1;5C\x1b[1;5D\x1b[1;3C\x1b" "b\x1b" "f", 0 },
+    { "ctrl keys", "\x01\x05\x0b\x17\x0c\x02\x06", 0 },
+};
+
+static tCli cli;
+static volatile int sink;
+
+#if CLI_CFG_LATENCY
+/* One core: the "ISR" thread and the main loop never run CLI code at the same time */
+static pthread_mutex_t cpu = PTHREAD_MUTEX_INITIALIZER;
+static sem_t line_sem;
+static volatile int is_typing_done;
+static unsigned long latencies[BENCH_LINES];
+#endif
+
+/* CliRxISR's decoding before the table, with the line editing taken out. Not inlined, a call
+ * like CliEscKey from the other file */
+__attribute__((noinline)) static int BenchSwitchKey(unsigned char rec_char)
+{
+    static enum
+    {
+        eNO_ESC_SEQ, eESC_RECVD, eO_RECVD, eBRCKT_RECVD, eESC_NUM, eVT_SEQ
+    } esc_state = eNO_ESC_SEQ;
+    static char esc_number = 0;
+    int key = eKEY_NONE;
+
+    switch (rec_char)
+    {
+        case '\n':
+        case '\r':
+            return eKEY_ENTER;
+        case '\t':
+            return eKEY_TAB;
+        case '\b':
+        case 127:
+            return eKEY_BACKSPACE;
+        default:
+            break;
+    }
+
+    switch (esc_state)
+    {
+        case eNO_ESC_SEQ:
+            if (rec_char == 27)
+            {
+                esc_state = eESC_RECVD;
+            }
+            else
+            {
+                key = eKEY_INSERT;
+            }
+            break;
+        case eESC_RECVD:
+            if (rec_char == '[')
+            {
+                esc_state = eBRCKT_RECVD;
+            }
+            else if (rec_char == 'O')
+            {
+                esc_state = eO_RECVD;
+            }
+            else
+            {
+                esc_state = eNO_ESC_SEQ;
+            }
+            break;
+        case eO_RECVD:
+        case eBRCKT_RECVD:
+            if (rec_char > '0' && rec_char < '9')
+            {
+                esc_number = rec_char - '0';
+                esc_state = eESC_NUM;
+                break;
+            }
+            else if (rec_char == 'a' || rec_char == 'A')
+            {
+                key = eKEY_UP;
+            }
+            else if (rec_char == 'b' || rec_char == 'B')
+            {
+                key = eKEY_DOWN;
+            }
+            else if (rec_char == 'c' || rec_char == 'C')
+            {
+                key = eKEY_RIGHT;
+            }
+            else if (rec_char == 'd' || rec_char == 'D')
+            {
+                key = eKEY_LEFT;
+            }
+            else if (rec_char == 'h' || rec_char == 'H')
+            {
+                key = eKEY_HOME;
+            }
+            else if (rec_char == 'f' || rec_char == 'F')
+            {
+                key = eKEY_END;
+            }
+            esc_state = eNO_ESC_SEQ;
+            break;
+        case eESC_NUM:
+            if (rec_char != '~')
+            {
+                esc_number = 0;
+                esc_state = eNO_ESC_SEQ;
+                break;
+            }
+            esc_state = eVT_SEQ;
+            /* fall through */
+        case eVT_SEQ:
+            switch (esc_number)
+            {
+                case 1:
+                    key = eKEY_HOME;
+                    break;
+                case 3:
+                    key = eKEY_DELETE;
+                    break;
+                case 4:
+                    key = eKEY_END;
+                    break;
+                default:
+                    break;
+            }
+            esc_number = 0;
+            esc_state = eNO_ESC_SEQ;
+            break;
+        default:
+            break;
+    }
+
+    return key;
+}
+
+static int BenchTableKey(unsigned char rec_char)
+{
+    return CliEscKey(rec_char);
+}
+
+static int BenchRxChar(unsigned char rec_char)
+{
+    CliRxChar(&cli, rec_char);
+    if (cli.was_input_received)
+    {
+        CliHandleSession(&cli);
+    }
+    cli.line[0] = 0;  // keep the line short, its editing isn't what's timed
+    cli.idx = 0;
+
+    return 0;
+}
+
+/* ns per byte of one run. Inlined, so each decoder is a direct call in its own loop like in
+ * CliRxChar, not a call through Decode */
+__attribute__((always_inline)) static inline double BenchOnce(int (*Decode)(unsigned char), const char *bytes, unsigned rounds)
+{
+    struct timespec t0, t1;
+    unsigned long num = 0;
+    int keys = 0;
+
+    for (const char *c = bytes; *c; ++c)
+    {
+        keys += Decode((unsigned char)*c);  // untimed, so the run starts with warm caches and predictors
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (unsigned r = 0; r < rounds; ++r)
+    {
+        for (const char *c = bytes; *c; ++c, ++num)
+        {
+            keys += Decode((unsigned char)*c);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    sink = keys;
+
+    return ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / num;
+}
+
+static double BenchBest(double best, double ns)
+{
+    return ns < best ? ns : best;
+}
+
+static void BenchEnable(void)
+{
+    char c = 0;
+
+    while (CliTxChar(&cli, &c))  // output is thrown away as fast as it comes
+    {
+    }
+}
+
+static void BenchDisable(void)
+{
+}
+
+#if CLI_CFG_LATENCY
+static void BenchLineReady(void)
+{
+    sem_post(&line_sem);
+}
+
+static void* BenchTypeLines(void *arg)
+{
+    unsigned long seed = 0x2545F491;
+
+    for (int n = 0; n < BENCH_LINES; ++n)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        usleep(100 + seed % BENCH_POLL_US);  // CR lands anywhere in a poll period
+
+        pthread_mutex_lock(&cpu);
+        CliHostSetIsr(1);
+        for (const char *c = "hello\r"; *c; ++c)
+        {
+            CliRxChar(&cli, *c);
+        }
+        CliHostSetIsr(0);
+        pthread_mutex_unlock(&cpu);
+
+        while (cli.was_input_received)
+        {
+            usleep(10);
+        }
+        latencies[n] = cli.last_latency;
+    }
+
+    is_typing_done = 1;
+    sem_post(&line_sem);
+
+    return NULL;
+}
+
+static int BenchCompare(const void *a, const void *b)
+{
+    unsigned long x = *(const unsigned long*)a;
+    unsigned long y = *(const unsigned long*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Lines typed by BenchTypeLines, run by polling or on LineReady: min, median and max latency */
+static void BenchDispatch(const char *name, int is_event)
+{
+    pthread_t typist;
+
+    cli.LineReady = is_event ? BenchLineReady : NULL;
+    is_typing_done = 0;
+    pthread_create(&typist, NULL, BenchTypeLines, NULL);
+
+    while (!is_typing_done)
+    {
+        if (is_event)
+        {
+            sem_wait(&line_sem);  // CliWaitForLine's WFI
+        }
+        else
+        {
+            usleep(BENCH_POLL_US);
+        }
+
+        pthread_mutex_lock(&cpu);
+        CliPeriodicCheck();
+        pthread_mutex_unlock(&cpu);
+    }
+
+    pthread_join(typist, NULL);
+
+    qsort(latencies, BENCH_LINES, sizeof(latencies[0]), BenchCompare);
+    printf("%-10s %8.1f %8.1f %8.1f\n", name, latencies[0] / 1e3, latencies[BENCH_LINES / 2] / 1e3,
+           latencies[BENCH_LINES - 1] / 1e3);
+}
+#endif
+
+int main(int argc, char **argv)
+{
+    unsigned runs = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_RUNS;
+    double t_table = 0;
+    double t_switch = 0;
+    double t_rx = 0;
+    double t_table_sum = 0;
+    double t_switch_sum = 0;
+    int is_slower = 0;
+
+    cli.EnableUartInt = BenchEnable;
+    cli.DisableUartInt = BenchDisable;
+    CliAddSession(&cli);
+
+    printf("%-10s %8s %8s %8s   ns/byte\n", "input", "table", "switch", "rx char");
+    for (unsigned i = 0; i < sizeof(inputs) / sizeof(inputs[0]); ++i)
+    {
+        t_table = t_switch = t_rx = 1e30;
+
+        /* the runs alternate, so a change of clock frequency hits both decoders alike */
+        for (unsigned run = 0; run < runs; ++run)
+        {
+            p_cli = &cli;  // CliEscKey works on p_cli, like from CliRxChar
+            t_table = BenchBest(t_table, BenchOnce(BenchTableKey, inputs[i].bytes, BENCH_ROUNDS));
+            t_switch = BenchBest(t_switch, BenchOnce(BenchSwitchKey, inputs[i].bytes, BENCH_ROUNDS));
+            t_rx = BenchBest(t_rx, BenchOnce(BenchRxChar, inputs[i].bytes, BENCH_ROUNDS / 8));
+        }
+
+        printf("%-10s %8.2f %8.2f %8.2f%s\n", inputs[i].name, t_table, t_switch, t_rx,
+               inputs[i].is_switch_key ? "" : "   (keys the switch didn't have)");
+
+        if (t_table > t_switch * BENCH_INPUT_TOLERANCE)
+        {
+            is_slower = 1;
+        }
+        t_table_sum += t_table;
+        t_switch_sum += t_switch;
+    }
+
+    printf("%-10s %8.2f %8.2f\n", "total", t_table_sum, t_switch_sum);
+    if (t_table_sum > t_switch_sum * BENCH_TOLERANCE)
+    {
+        is_slower = 1;
+    }
+
+    if (is_slower)
+    {
+        printf("the table is slower than the switch\n");
+    }
+
+#if CLI_CFG_LATENCY
+    sem_init(&line_sem, 0, 0);
+    printf("\n%-10s %8s %8s %8s   us from CR to callback\n", "dispatch", "min", "median", "max");
+    BenchDispatch("polling", 0);
+    BenchDispatch("LineReady", 1);
+#endif
+
+    return is_slower;
+}
@@ -0,0 +1,804 @@
+/*
+ * cli_fuzz.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Fuzz target for the key decoder on the host, with libFuzzer:
+ *     clang -g -O1 -fsanitize=fuzzer,address,undefined -DCLI_FUZZ_LIBFUZZER -Icli cli/cli*.c tools/cli_fuzz.c -o cli_fuzz
+ *     ./cli_fuzz [corpus dir]
+ * or without it, running generated inputs (and any files given):
+ *     gcc -g -fsanitize=address,undefined -Icli cli/cli*.c tools/cli_fuzz.c -o cli_fuzz
+ *     ./cli_fuzz [-n <inputs>] [file]...
+ * Every byte goes through CliEscKey and through FuzzRefKey, a plain switch written from the
+ * key list in tools/gen_esc_table.py, and the keys must match. After each byte the decoder
+ * state must be in range, and after each input "ESC [ 1 ; 5 C" must still decode to a word
+ * motion, whatever state the input left behind, and terminal replies with private parameters
+ * (DA, SGR mouse) must decode to no key at all.
+ * Then the input goes through CliRxChar as the Rx ISR, its output is drained through CliTxChar
+ * and complete lines run. After each byte the line, idx and the packed history must be in
+ * range and equal to tRefLine, a model of the editor fed with FuzzRefKey's keys, and neither
+ * ISR may have taken longer than CLI_ISR_BUDGET. Everything sent goes through tRefTerm, a
+ * terminal of one row, which must then show the prompt and the model's line with the cursor
+ * at idx. A mismatch prints the input and aborts.
+ */
+
+#include "cli.h"
+#include "cli_esc_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FUZZ_MAX_LEN 64         // generated inputs
+#define FUZZ_BUDGET_RUNS 5      // timings of a byte over CLI_ISR_BUDGET before it fails
+#define FUZZ_PROMPT "> "        // the prompt of cli.c, without its '\r'
+#define LEN_TERM_ROW 256
+
+typedef struct
+{
+    enum
+    {
+        eREF_GROUND, eREF_ESC, eREF_CSI, eREF_SS3, eREF_CSI_SKIP
+    } state;
+    unsigned idx;
+    unsigned params[NUM_ESC_PARAMS];
+} tRefDecoder;
+
+typedef struct
+{
+    char line[LEN_STD_STR];
+    int idx;
+    char entries[LEN_HISTORY / 2][LEN_STD_STR];  // oldest first, each at least 2 bytes packed
+    unsigned num_entries;
+    unsigned pos;       // entry on display, num_entries for the live line
+    char stash[LEN_STD_STR];
+} tRefLine;
+
+typedef struct
+{
+    char row[LEN_TERM_ROW];     // the cursor's row, blanks where nothing was written
+    unsigned len;               // written up to here
+    unsigned col;
+    enum
+    {
+        eTERM_TEXT, eTERM_ESC, eTERM_CSI
+    } state;
+    unsigned param;
+    int bad;                    // the first byte it doesn't know, plus 1
+} tRefTerm;
+
+static tCli cli;
+static tRefDecoder ref;
+static tRefLine model;
+static tRefTerm term;
+static unsigned long t_max = 0;  // slowest byte so far, in ns
+
+static int FuzzRefCtrl(unsigned char c)
+{
+    switch (c | 0x40)
+    {
+        case 'A': return eKEY_HOME;
+        case 'B': return eKEY_LEFT;
+        case 'C': return eKEY_ABORT;
+        case 'D': return eKEY_DELETE;
+        case 'E': return eKEY_END;
+        case 'F': return eKEY_RIGHT;
+        case 'I': return eKEY_TAB;
+        case 'J': return eKEY_ENTER;
+        case 'K': return eKEY_KILL_EOL;
+        case 'L': return eKEY_REDRAW;
+        case 'M': return eKEY_ENTER;
+        case 'N': return eKEY_DOWN;
+        case 'P': return eKEY_UP;
+        case 'U': return eKEY_KILL_BOL;
+        case 'W': return eKEY_KILL_WORD;
+        default: return eKEY_NONE;
+    }
+}
+
+static int FuzzRefFinal(unsigned char c, unsigned modifier)
+{
+    int key = eKEY_NONE;
+
+    switch (c)
+    {
+        case 'A': case 'a': key = eKEY_UP; break;
+        case 'B': case 'b': key = eKEY_DOWN; break;
+        case 'C': key = eKEY_RIGHT; break;
+        case 'D': key = eKEY_LEFT; break;
+        case 'c': key = eKEY_WORD_RIGHT; break;
+        case 'd': key = eKEY_WORD_LEFT; break;
+        case 'H': key = eKEY_HOME; break;
+        case 'F': key = eKEY_END; break;
+        default: break;
+    }
+
+    if (modifier > 2 && key == eKEY_RIGHT)
+    {
+        key = eKEY_WORD_RIGHT;
+    }
+    else if (modifier > 2 && key == eKEY_LEFT)
+    {
+        key = eKEY_WORD_LEFT;
+    }
+
+    return key;
+}
+
+static int FuzzRefKey(unsigned char c)
+{
+    int state = ref.state;
+    int is_alpha = (c | 0x20) >= 'a' && (c | 0x20) <= 'z';
+
+    ref.state = eREF_GROUND;  // most bytes end a sequence
+
+    if (c == 0x1B)
+    {
+        ref.state = eREF_ESC;
+        return eKEY_NONE;
+    }
+    if (c == 0x7F || c == 0x08)
+    {
+        return state == eREF_ESC ? eKEY_KILL_WORD : eKEY_BACKSPACE;
+    }
+    if (c < 0x20)
+    {
+        return FuzzRefCtrl(c);
+    }
+
+    switch (state)
+    {
+        case eREF_GROUND:
+            return c < 0x80 ? eKEY_INSERT : eKEY_NONE;
+        case eREF_ESC:
+            if (c == '[' || c == 'O')
+            {
+                ref.state = c == '[' ? eREF_CSI : eREF_SS3;
+                ref.idx = 0;
+                ref.params[0] = ref.params[1] = 0;
+                return eKEY_NONE;
+            }
+            return c == 'b' || c == 'B' ? eKEY_WORD_LEFT : c == 'f' || c == 'F' ? eKEY_WORD_RIGHT : eKEY_NONE;
+        case eREF_CSI_SKIP:
+            if (c >= 0x20 && c < 0x40)
+            {
+                ref.state = eREF_CSI_SKIP;  // private parameters and intermediates, up to the final byte
+            }
+            return eKEY_NONE;
+        case eREF_CSI:
+        case eREF_SS3:
+            if (c >= '0' && c <= '9')
+            {
+                ref.state = state;
+                if (ref.idx < NUM_ESC_PARAMS)
+                {
+                    ref.params[ref.idx] = ref.params[ref.idx] * 10 + c - '0';
+                    ref.params[ref.idx] = ref.params[ref.idx] > 255 ? 255 : ref.params[ref.idx];
+                }
+                return eKEY_NONE;
+            }
+            if (state == eREF_CSI && c >= 0x20 && c < 0x40 && c != ';')
+            {
+                ref.state = eREF_CSI_SKIP;
+                return eKEY_NONE;
+            }
+            if (state == eREF_CSI && (c == ';' || c == '['))
+            {
+                ref.state = eREF_CSI;
+                ref.idx += c == ';' && ref.idx < NUM_ESC_PARAMS;
+                return eKEY_NONE;
+            }
+            if (state == eREF_CSI && c == '~')
+            {
+                switch (ref.params[0])
+                {
+                    case 1: case 7: return eKEY_HOME;
+                    case 3: return eKEY_DELETE;
+                    case 4: case 8: return eKEY_END;
+                    default: return eKEY_NONE;
+                }
+            }
+            if (c < 0x80 && is_alpha)
+            {
+                return FuzzRefFinal(c, ref.params[state == eREF_CSI ? 1 : 0]);
+            }
+            return eKEY_NONE;
+        default:
+            return eKEY_NONE;
+    }
+}
+
+static void FuzzFail(const unsigned char *data, size_t size, size_t at, const char *what)
+{
+    fprintf(stderr, "%s at byte %zu of:", what, at);
+    for (size_t i = 0; i < size; ++i)
+    {
+        fprintf(stderr, " %02X", data[i]);
+    }
+    fprintf(stderr, "\n");
+    abort();
+}
+
+static void FuzzDecode(const unsigned char *data, size_t size)
+{
+    static const unsigned char word_right[] = { 0x1B, '[', '1', ';', '5', 'C' };
+    static const char *const replies[] = { "\x1b[?1;2c", "\x1b[<0;10;5M", "\x1b[>1;10;0c" };  // DA, SGR mouse
+    int key = 0;
+
+    cli.esc_state = eESC_GROUND;
+    cli.esc_param_idx = 0;
+    ref.state = eREF_GROUND;
+    ref.idx = 0;
+    p_cli = &cli;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        key = CliEscKey(data[i]);
+        if (key != FuzzRefKey(data[i]))
+        {
+            FuzzFail(data, size, i, "key differs from the reference");
+        }
+        if (key > eKEY_ABORT || cli.esc_state > eESC_CSI_SKIP || cli.esc_param_idx > NUM_ESC_PARAMS)
+        {
+            FuzzFail(data, size, i, "decoder state out of range");
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(word_right); ++i)
+    {
+        key = CliEscKey(word_right[i]);
+        if (key != (i + 1 < sizeof(word_right) ? eKEY_NONE : eKEY_WORD_RIGHT))
+        {
+            FuzzFail(data, size, size, "ESC [ 1 ; 5 C doesn't decode after");
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(replies) / sizeof(replies[0]); ++i)
+    {
+        for (const char *c = replies[i]; *c; ++c)
+        {
+            if (CliEscKey(*c) != eKEY_NONE)
+            {
+                FuzzFail((const unsigned char *)replies[i], strlen(replies[i]), c - replies[i], "terminal reply decodes to a key");
+            }
+        }
+        if (cli.esc_state != eESC_GROUND)
+        {
+            FuzzFail((const unsigned char *)replies[i], strlen(replies[i]), strlen(replies[i]), "terminal reply doesn't end");
+        }
+    }
+}
+
+static int FuzzIsBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+#if CLI_CFG_HISTORY
+static void FuzzRefShow(const char *text)
+{
+    strcpy(model.line, text);
+    model.idx = strlen(model.line);
+}
+
+static void FuzzRefPush(void)
+{
+    unsigned len = strlen(model.line) + 1;
+    unsigned used = 0;
+
+    if (model.num_entries && !strcmp(model.entries[model.num_entries - 1], model.line))
+    {
+        model.pos = model.num_entries;
+        return;
+    }
+    if (len > LEN_HISTORY)
+    {
+        return;
+    }
+
+    for (unsigned i = 0; i < model.num_entries; ++i)
+    {
+        used += strlen(model.entries[i]) + 1;
+    }
+    while (used + len > LEN_HISTORY)
+    {
+        used -= strlen(model.entries[0]) + 1;
+        memmove(model.entries[0], model.entries[1], --model.num_entries * sizeof(model.entries[0]));
+    }
+
+    strcpy(model.entries[model.num_entries++], model.line);
+    model.pos = model.num_entries;
+}
+#endif
+
+static void FuzzRefRemove(int at)
+{
+    memmove(&model.line[at], &model.line[at + 1], strlen(&model.line[at]));
+}
+
+/* What a key does to the line, as the README describes it. The arena is empty before every byte
+ * here and holds any echo of a full line, so no edit is refused for want of room */
+static void FuzzRefEdit(int key, unsigned char c)
+{
+    char *line = model.line;
+    int len = strlen(line);
+    int idx = model.idx;
+
+    switch (key)
+    {
+        case eKEY_INSERT:
+            if (len + 1 < LEN_STD_STR - 1)
+            {
+                memmove(&line[idx + 1], &line[idx], len - idx + 1);
+                line[model.idx++] = c;
+            }
+            break;
+        case eKEY_ENTER:
+            if (line[0] && !FuzzIsBlank(line[0]))
+            {
+#if CLI_CFG_HISTORY
+                FuzzRefPush();
+#endif
+            }
+            line[0] = 0;
+            model.idx = 0;
+            break;
+        case eKEY_BACKSPACE:
+            if (idx)
+            {
+                FuzzRefRemove(--model.idx);
+            }
+            break;
+        case eKEY_ABORT:
+            line[0] = 0;
+            model.idx = 0;
+            break;
+#if CLI_CFG_HISTORY
+        case eKEY_UP:
+            if (model.pos)
+            {
+                if (model.pos == model.num_entries)
+                {
+                    strcpy(model.stash, line);
+                }
+                FuzzRefShow(model.entries[--model.pos]);
+            }
+            break;
+        case eKEY_DOWN:
+            if (model.pos < model.num_entries)
+            {
+                ++model.pos;
+                FuzzRefShow(model.pos == model.num_entries ? model.stash : model.entries[model.pos]);
+            }
+            break;
+#endif
+#if CLI_CFG_NAVIGATION
+        case eKEY_DELETE:
+            if (idx < len)
+            {
+                FuzzRefRemove(idx);
+            }
+            break;
+        case eKEY_RIGHT:
+            model.idx += idx < len;
+            break;
+        case eKEY_LEFT:
+            model.idx -= idx > 0;
+            break;
+        case eKEY_HOME:
+            model.idx = 0;
+            break;
+        case eKEY_END:
+            model.idx = len;
+            break;
+        case eKEY_WORD_RIGHT:
+            while (FuzzIsBlank(line[model.idx]))
+            {
+                ++model.idx;
+            }
+            while (line[model.idx] && !FuzzIsBlank(line[model.idx]))
+            {
+                ++model.idx;
+            }
+            break;
+        case eKEY_WORD_LEFT:
+        case eKEY_KILL_WORD:
+            while (model.idx && FuzzIsBlank(line[model.idx - 1]))
+            {
+                --model.idx;
+            }
+            while (model.idx && !FuzzIsBlank(line[model.idx - 1]))
+            {
+                --model.idx;
+            }
+            if (key == eKEY_KILL_WORD)
+            {
+                memmove(&line[model.idx], &line[idx], len - idx + 1);
+            }
+            break;
+        case eKEY_KILL_EOL:
+            line[idx] = 0;
+            break;
+        case eKEY_KILL_BOL:
+            memmove(line, &line[idx], len - idx + 1);
+            model.idx = 0;
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+/* The terminal at the other end, as much of it as the editor uses: text, \b, \r, \n, \t, \a,
+ * ESC [ n C, ESC [ n D, ESC [ K, ESC [ 2 J and ESC [ H. Only the cursor's row is kept, a new
+ * line starts blank */
+static void FuzzTermByte(unsigned char c)
+{
+    if (term.state == eTERM_ESC)
+    {
+        term.state = c == '[' ? eTERM_CSI : eTERM_TEXT;
+        term.param = 0;
+        term.bad = term.bad ? term.bad : c == '[' ? 0 : c + 1;
+        return;
+    }
+    if (term.state == eTERM_CSI)
+    {
+        if (c >= '0' && c <= '9')
+        {
+            term.param = term.param < 1000 ? term.param * 10 + c - '0' : term.param;
+            return;
+        }
+        term.state = eTERM_TEXT;
+        switch (c)
+        {
+            case 'C':
+                term.col += term.param ? term.param : 1;
+                return;
+            case 'D':
+                term.col -= term.param < term.col ? (term.param ? term.param : 1) : term.col;
+                return;
+            case 'K':
+                if (!term.param)
+                {
+                    term.len = term.col < term.len ? term.col : term.len;
+                    return;
+                }
+                break;
+            case 'J':
+                if (term.param == 2)
+                {
+                    term.len = 0;  // ESC [ H follows, to the top row, blank now
+                    return;
+                }
+                break;
+            case 'H':
+                if (!term.param)
+                {
+                    term.col = 0;
+                    return;
+                }
+                break;
+            default:
+                break;
+        }
+        term.bad = term.bad ? term.bad : c + 1;
+        return;
+    }
+
+    switch (c)
+    {
+        case 0x1B:
+            term.state = eTERM_ESC;
+            break;
+        case '\b':
+            term.col -= term.col > 0;
+            break;
+        case '\r':
+            term.col = 0;
+            break;
+        case '\n':
+            term.len = 0;
+            break;
+        case '\t':
+            term.col = (term.col + 8) & ~7u;
+            break;
+        case '\a':
+            break;
+        default:
+            if (c < 0x20 || c > 0x7E)
+            {
+                term.bad = term.bad ? term.bad : c + 1;
+                break;
+            }
+            while (term.len < term.col && term.len < LEN_TERM_ROW)
+            {
+                term.row[term.len++] = ' ';
+            }
+            if (term.col < LEN_TERM_ROW)
+            {
+                term.row[term.col] = c;
+                term.len += term.col == term.len;
+            }
+            ++term.col;
+            break;
+    }
+}
+
+/* One received byte as the ISRs see it, then its output drained: the most ns any of those took */
+static unsigned long FuzzRxByteOnce(unsigned char b)
+{
+    unsigned long t_start = 0;
+    unsigned long t_slowest = 0;
+    int is_sent = 1;
+    char c = 0;
+
+    CliHostSetIsr(1);
+
+    t_start = CliGetCycles();
+    CliRxChar(&cli, b);
+    t_slowest = CliGetCycles() - t_start;
+
+    while (is_sent)
+    {
+        t_start = CliGetCycles();
+        is_sent = CliTxChar(&cli, &c);
+        t_start = CliGetCycles() - t_start;
+        t_slowest = t_start > t_slowest ? t_start : t_slowest;
+        if (is_sent)
+        {
+            FuzzTermByte(c);
+        }
+    }
+
+    CliHostSetIsr(0);
+
+    return t_slowest;
+}
+
+/* CliGetCycles counts wall-clock ns on the host, preemption included, so a byte over the budget
+ * is run again from the same session state and the fastest run is its cost */
+static unsigned long FuzzRxByte(unsigned char b)
+{
+    tCli before = cli;
+    tRefTerm term_before = term;
+    unsigned long t_byte = FuzzRxByteOnce(b);
+    unsigned long t_run = 0;
+
+    for (int run = 1; run < FUZZ_BUDGET_RUNS && t_byte > CLI_ISR_BUDGET; ++run)
+    {
+        cli = before;
+        term = term_before;
+        t_run = FuzzRxByteOnce(b);
+        t_byte = t_run < t_byte ? t_run : t_byte;
+    }
+
+    return t_byte;
+}
+
+#if CLI_CFG_HISTORY
+static void FuzzCheckHistory(const unsigned char *data, size_t size, size_t at)
+{
+    char packed[LEN_HISTORY];
+    unsigned used = 0;
+    unsigned pos = 0;
+
+    for (unsigned i = 0; i < model.num_entries; ++i)
+    {
+        pos = i < model.pos ? used + strlen(model.entries[i]) + 1 : pos;
+        memcpy(&packed[used], model.entries[i], strlen(model.entries[i]) + 1);
+        used += strlen(model.entries[i]) + 1;
+    }
+
+    if (cli.history_len > LEN_HISTORY || cli.history_pos > cli.history_len
+        || (cli.history_len && cli.history[cli.history_len - 1])
+        || (cli.history_pos && cli.history[cli.history_pos - 1]))
+    {
+        FuzzFail(data, size, at, "history out of range");
+    }
+    if (cli.history_len != used || memcmp(cli.history, packed, used) || cli.history_pos != pos)
+    {
+        FuzzFail(data, size, at, "history differs from the model");
+    }
+}
+#endif
+
+static void FuzzCheckLine(const unsigned char *data, size_t size, size_t at)
+{
+    size_t len = strnlen(cli.line, LEN_STD_STR);
+
+    if (len > LEN_STD_STR - 2 || cli.idx < 0 || (size_t)cli.idx > len)
+    {
+        FuzzFail(data, size, at, "line or idx out of range");
+    }
+    if (strcmp(cli.line, model.line) || cli.idx != model.idx)
+    {
+        fprintf(stderr, "line \"%s\" idx %d, the model has \"%s\" idx %d\n", cli.line, cli.idx, model.line, model.idx);
+        FuzzFail(data, size, at, "line differs from the model");
+    }
+    if (cli.was_input_received || cli.out_tail != cli.out_head || cli.tx_buffer || cli.arena_used > LEN_ARENA)
+    {
+        FuzzFail(data, size, at, "session not idle after the byte");
+    }
+
+#if CLI_CFG_HISTORY
+    FuzzCheckHistory(data, size, at);
+#endif
+}
+
+/* Trailing blanks don't show, on the screen or at the end of the line */
+static void FuzzCheckScreen(const unsigned char *data, size_t size, size_t at)
+{
+    char shown[LEN_TERM_ROW];
+    int len = snprintf(shown, sizeof(shown), FUZZ_PROMPT "%s", model.line);
+    unsigned len_row = term.len;
+
+    if (term.bad)
+    {
+        fprintf(stderr, "byte %02X\n", term.bad - 1);
+        FuzzFail(data, size, at, "the editor sent a byte the terminal doesn't know");
+    }
+
+    while (len && shown[len - 1] == ' ')
+    {
+        --len;
+    }
+    while (len_row && term.row[len_row - 1] == ' ')
+    {
+        --len_row;
+    }
+    if (len_row != (unsigned)len || memcmp(term.row, shown, len) || term.col != strlen(FUZZ_PROMPT) + model.idx)
+    {
+        fprintf(stderr, "screen \"%.*s\" column %u, the model has \"%.*s\" column %u\n", (int)len_row, term.row,
+                term.col, len, shown, (unsigned)(strlen(FUZZ_PROMPT) + model.idx));
+        FuzzFail(data, size, at, "screen differs from the model");
+    }
+}
+
+/* The same bytes through CliRxChar, each checked against the model and the ISR budget */
+static void FuzzEdit(const unsigned char *data, size_t size)
+{
+    unsigned long t_byte = 0;
+    int key = 0;
+
+    cli.esc_state = eESC_GROUND;
+    cli.esc_param_idx = 0;
+    cli.line[0] = 0;
+    cli.idx = 0;
+#if CLI_CFG_HISTORY
+    cli.history_len = 0;
+    cli.history_pos = 0;
+    cli.stash[0] = 0;
+#endif
+    memset(&model, 0, sizeof(model));
+    memset(&term, 0, sizeof(term));
+    strcpy(term.row, FUZZ_PROMPT);  // the prompt of the line before, on screen already
+    term.len = term.col = strlen(FUZZ_PROMPT);
+    ref.state = eREF_GROUND;
+    ref.idx = 0;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        key = FuzzRefKey(data[i]);
+        FuzzRefEdit(key, data[i]);
+
+        t_byte = FuzzRxByte(data[i]);
+        if (t_byte > CLI_ISR_BUDGET)
+        {
+            fprintf(stderr, "%lu ns\n", t_byte);
+            FuzzFail(data, size, i, "byte over CLI_ISR_BUDGET");
+        }
+        t_max = t_byte > t_max ? t_byte : t_max;
+
+        if (cli.was_input_received)
+        {
+            CliHandleSession(&cli);  // runs the line, anything it printed is drained by FuzzEnable
+        }
+
+#if CLI_CFG_COMPLETION
+        /* completion only appends, and only at the end of the line */
+        if (key == eKEY_TAB)
+        {
+            if (model.idx != (int)strlen(model.line) ? strcmp(cli.line, model.line) || cli.idx != model.idx
+                : strncmp(cli.line, model.line, model.idx) || cli.idx != (int)strlen(cli.line))
+            {
+                FuzzFail(data, size, i, "completion changed the line before the cursor");
+            }
+            strcpy(model.line, cli.line);
+            model.idx = cli.idx;
+        }
+#endif
+
+        FuzzCheckLine(data, size, i);
+        FuzzCheckScreen(data, size, i);
+    }
+}
+
+static void FuzzEnable(void)
+{
+    char c = 0;
+
+    if (CliIsInIsr())
+    {
+        return;  // FuzzRxByte drains after the Rx "ISR", like a Tx ISR of the same priority
+    }
+
+    while (CliTxChar(&cli, &c))
+    {
+        FuzzTermByte(c);
+    }
+}
+
+static void FuzzDisable(void)
+{
+}
+
+int LLVMFuzzerTestOneInput(const unsigned char *data, size_t size)
+{
+    if (!cli.EnableUartInt)
+    {
+        cli.EnableUartInt = FuzzEnable;
+        cli.DisableUartInt = FuzzDisable;
+        CliAddSession(&cli);
+    }
+
+    FuzzDecode(data, size);
+    FuzzEdit(data, size);
+
+    return 0;
+}
+
+#ifndef CLI_FUZZ_LIBFUZZER
+/* Mostly bytes that mean something to the decoder and the editor, so sequences get deep and lines run */
+static unsigned char FuzzByte(unsigned long *seed)
+{
+    static const char alphabet[] = "\x1b\x1b\x1b[[O;;~?<$0123456789ABCDFHabcdfO~\x01\x03\x08\x0b\x15\x17\x7f ax\r\r\the";
+
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 7;
+    *seed ^= *seed << 17;
+
+    return *seed % 8 ? (unsigned char)alphabet[(*seed >> 8) % (sizeof(alphabet) - 1)] : (unsigned char)(*seed >> 16);
+}
+
+int main(int argc, char **argv)
+{
+    unsigned char data[4096];
+    unsigned long num_inputs = 1000000;
+    unsigned long seed = 0x2545F491;
+    size_t size = 0;
+    FILE *file = NULL;
+    int num_files = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            num_inputs = strtoul(argv[++i], NULL, 0);
+            continue;
+        }
+        if (!(file = fopen(argv[i], "rb")))
+        {
+            perror(argv[i]);
+            return 1;
+        }
+        size = fread(data, 1, sizeof(data), file);
+        fclose(file);
+        LLVMFuzzerTestOneInput(data, size);
+        ++num_files;
+    }
+
+    for (unsigned long n = 0; !num_files && n < num_inputs; ++n)
+    {
+        size = FuzzByte(&seed) % FUZZ_MAX_LEN;
+        for (size_t i = 0; i < size; ++i)
+        {
+            data[i] = FuzzByte(&seed);
+        }
+        LLVMFuzzerTestOneInput(data, size);
+    }
+
+    printf("%lu inputs ok, %lu ns for the slowest byte\n", num_files ? (unsigned long)num_files : num_inputs, t_max);
+
+    return 0;
+}
+#endif
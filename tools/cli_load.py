@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+#
+# cli_load.py
+#
+# MIT License
+#
+# Copyright (c) 2021 Wesley Becker
+#
+# Load test for tools/cli_server.c: opens many sessions at once, each runs a command over and
+# over, and prints the latency per session (command sent to the prompt back) and overall.
+#
+#   cli_load.py --unix /tmp/cli.sock [-n 16] [--count 200] [--cmd hello] [--expect 'Hello World!']
+#   cli_load.py --tcp 2323 -n 8
+#
+# Sessions past CLI_MAX_SESSIONS are refused by the server and counted as errors.
+# Exits with 1 if any session failed or got an unexpected reply.
+
+import argparse
+import socket
+import sys
+import threading
+import time
+
+PROMPT_BACK = b'\r\n\r> '   # after the output of every line
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p))] if values else 0
+
+
+def read_until(sock, end):
+    data = bytearray()
+    while not data.endswith(end):
+        chunk = sock.recv(4096)
+        if not chunk:
+            raise ConnectionError('closed by the server')
+        data += chunk
+    return bytes(data)
+
+
+def session(args, start, result):
+    sock = socket.socket(socket.AF_UNIX if args.unix else socket.AF_INET)
+    sock.settimeout(args.timeout)
+    try:
+        sock.connect(args.unix or ('127.0.0.1', args.tcp))
+        read_until(sock, b'> ')                 # first prompt
+    except (OSError, ConnectionError) as e:
+        result['error'] = str(e) or type(e).__name__
+    start.wait()                                # all at once, connected or not
+    try:
+        for _ in range(args.count if not result['error'] else 0):
+            t = time.monotonic()
+            sock.sendall(args.cmd.encode() + b'\r')
+            reply = read_until(sock, PROMPT_BACK)
+            result['lat'].append(time.monotonic() - t)
+            if args.expect.encode() not in reply:
+                result['bad'] += 1
+    except (OSError, ConnectionError) as e:
+        result['error'] = str(e) or type(e).__name__
+    finally:
+        sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='many simultaneous CLI sessions, latency per session')
+    where = parser.add_mutually_exclusive_group(required=True)
+    where.add_argument('--unix', help='Unix-domain socket path')
+    where.add_argument('--tcp', type=int, help='loopback TCP port')
+    parser.add_argument('-n', '--sessions', type=int, default=16)
+    parser.add_argument('--count', type=int, default=200, help='commands per session')
+    parser.add_argument('--cmd', default='hello')
+    parser.add_argument('--expect', default='Hello World!', help='text every reply must hold')
+    parser.add_argument('--timeout', type=float, default=5.0)
+    args = parser.parse_args()
+
+    results = [{'lat': [], 'bad': 0, 'error': None} for _ in range(args.sessions)]
+    start = threading.Barrier(args.sessions + 1)
+    threads = [threading.Thread(target=session, args=(args, start, r)) for r in results]
+    for t in threads:
+        t.start()
+    start.wait()
+    t_start = time.monotonic()
+    for t in threads:
+        t.join()
+    t_total = time.monotonic() - t_start
+
+    print('session  cmds   p50 ms   p99 ms   max ms  bad  error')
+    failed = 0
+    for i, r in enumerate(results):
+        lat = r['lat']
+        print('%7d %5d %8.3f %8.3f %8.3f %4d  %s' % (i, len(lat), percentile(lat, 0.5) * 1e3,
+              percentile(lat, 0.99) * 1e3, max(lat, default=0) * 1e3, r['bad'], r['error'] or ''))
+        failed += bool(r['bad'] or r['error'])
+
+    lat = [x for r in results for x in r['lat']]
+    print('all     %5d %8.3f %8.3f %8.3f, %.0f cmds/s, %d of %d sessions failed'
+          % (len(lat), percentile(lat, 0.5) * 1e3, percentile(lat, 0.99) * 1e3, max(lat, default=0) * 1e3,
+             len(lat) / t_total if t_total else 0, failed, args.sessions))
+
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+#
+# cli_lzterm.py
+#
+# MIT License
+#
+# Copyright (c) 2021 Wesley Becker
+#
+# Terminal for a CLI built with CLI_CFG_COMPRESS: turns on "compress" and decodes the output
+# (see cli/cli_lz.c for the format). Ctrl-] quits, turning it off again.
+#
+#   cli_lzterm.py /dev/ttyUSB0 [--baud 115200]
+#   printf 'help\r' | cli_lzterm.py /dev/ttyUSB0      # not a tty: sends stdin, quits at its end
+#
+# Prints the bytes received against the text they decoded to when done.
+
+import argparse
+import os
+import re
+import select
+import sys
+import termios
+import time
+import tty
+
+from cli_xfer import BAUDS, Port
+
+QUIT = b'\x1d'      # Ctrl-]
+LZ_MATCH, LZ_ESCAPE, LZ_MIN_MATCH = 0x80, 0xFF, 3
+
+
+class Decoder:
+    def __init__(self, window):
+        self.window = bytearray(window)
+        self.pos = 0
+        self.token = None       # first byte of a two byte token
+        self.ended = False      # "compress off" seen, plain text from here on
+        self.wire = 0
+        self.text = 0
+
+    def put(self, b, out):
+        self.window[self.pos] = b
+        self.pos = (self.pos + 1) % len(self.window)
+        self.text += 1
+        out.append(b)
+
+    def feed(self, data):
+        out = bytearray()
+        for i, b in enumerate(data):
+            if self.ended:
+                out += data[i:]
+                break
+            self.wire += 1
+            if self.token is None:
+                if b < LZ_MATCH:
+                    self.put(b, out)
+                else:
+                    self.token = b
+                continue
+            token, self.token = self.token, None
+            if token == LZ_ESCAPE:
+                if b:
+                    self.put(b, out)
+                else:
+                    self.ended = True
+            else:
+                start = self.pos - b - 1
+                for k in range(token - LZ_MATCH + LZ_MIN_MATCH):
+                    self.put(self.window[(start + k) % len(self.window)], out)
+        return bytes(out)
+
+
+def handshake(port, timeout=2.0):
+    """Window size from the answer, everything after it is coded."""
+    port.write(b'compress on\r')
+    data = bytearray()
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        b = port.read(0.1)
+        if b is None:
+            continue
+        data.append(b)
+        m = re.search(rb'compress: lz (\d+)\r\n', data)
+        if m:
+            return int(m.group(1))
+    sys.exit('no "compress: lz" answer, is the target built with CLI_CFG_COMPRESS?')
+
+
+def show(port, dec, timeout):
+    """Decoded output until the port is quiet for timeout."""
+    while select.select([port.fd], [], [], timeout)[0]:
+        os.write(sys.stdout.fileno(), dec.feed(os.read(port.fd, 4096)))
+
+
+def interactive(port, dec):
+    stdin = sys.stdin.fileno()
+    while True:
+        ready = select.select([stdin, port.fd], [], [])[0]
+        if port.fd in ready:
+            show(port, dec, 0)
+        if stdin in ready:
+            data = os.read(stdin, 256)
+            port.write(data.split(QUIT)[0])
+            if not data or QUIT in data:
+                return
+
+
+def piped(port, dec):
+    """One line at a time, the CLI drops what's typed while a line runs."""
+    for line in re.findall(rb'[^\r\n]*[\r\n]|[^\r\n]+$', sys.stdin.buffer.read()):
+        port.write(line.rstrip(b'\r\n') + b'\r')
+        show(port, dec, 0.3)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='CLI terminal with LZ coded output')
+    parser.add_argument('port')
+    parser.add_argument('--baud', type=int, default=115200, choices=sorted(BAUDS))
+    args = parser.parse_args()
+
+    port = Port(args.port, args.baud)
+    port.read_text(0.1)                     # drop whatever is pending
+    window = handshake(port)
+    dec = Decoder(window)
+
+    is_tty = os.isatty(sys.stdin.fileno())
+    saved = termios.tcgetattr(sys.stdin.fileno()) if is_tty else None
+    try:
+        if is_tty:
+            tty.setraw(sys.stdin.fileno())
+        interactive(port, dec) if is_tty else piped(port, dec)
+        show(port, dec, 0.1)
+        port.write(b'compress off\r')
+        deadline = time.monotonic() + 1.0
+        while not dec.ended and time.monotonic() < deadline:
+            b = port.read(0.1)
+            if b is not None:
+                os.write(sys.stdout.fileno(), dec.feed(bytes([b])))
+        os.write(sys.stdout.fileno(), port.read_text(0.2).encode())
+    finally:
+        if is_tty:
+            termios.tcsetattr(sys.stdin.fileno(), termios.TCSADRAIN, saved)
+
+    ratio = dec.text / dec.wire if dec.wire else 0
+    print('\nlz %d: %d B received for %d B of text, ratio %.2f, %.0f B/s of text at %d baud instead of %.0f'
+          % (window, dec.wire, dec.text, ratio, ratio * args.baud / 10, args.baud, args.baud / 10),
+          file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
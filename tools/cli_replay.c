@@ -0,0 +1,483 @@
+/*
+ * cli_replay.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Replays a "capture dump" (see cli/cli_capture.c) through CliRxChar/CliTxChar on the host:
+ *     gcc -Icli cli/cli*.c tools/cli_replay.c -o cli_replay
+ *     ./cli_replay [--baud 115200] [--speed 1] terminal.log
+ * terminal.log is anything holding the dump text, e.g. a screen/minicom log or a copy-paste;
+ * the last dump in it is used.
+ *
+ * Time is simulated: Rx bytes arrive at their recorded times (divided by --speed, 0 sends them
+ * back to back) but never faster than the line allows, the Tx "ISR" takes one byte time per
+ * byte, and both run as ISRs (CliIsInIsr() is 1), so a full queue drops echoes like on the
+ * target. Lines run right after their CR, their output is drained before they return. Prints
+ * the byte counts, the session's drop counters, per command latency (CR to the last byte of
+ * output) and whether the Tx bytes match the recorded ones (capture on -t). It also prints
+ * the most ns one Rx/Tx byte took, and exits with 2 if any took longer than the host's
+ * CLI_ISR_BUDGET (see cli_cfg.h), so inputs that blow up ISR time show. A byte over it is run
+ * again from the same session state and the fastest run counts, so preemption doesn't.
+ *
+ * Build it with the target's -D options, or e.g. help lists other commands. The replay
+ * session starts empty: no history, no macros, default variables, so captures that rely on
+ * earlier state can differ for that alone.
+ */
+
+#include "cli.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define CAPTURE_TX 0x80
+#define CAPTURE_LONG 0x7F
+#define MAX_REPLAY_CMDS 256
+#define LEN_DIFF_CONTEXT 24
+#define REPLAY_BUDGET_RUNS 5    // timings of a byte over CLI_ISR_BUDGET before it counts
+
+typedef struct
+{
+    double t_ms;        // since the first record
+    char is_tx;
+    char c;
+} tRecord;
+
+typedef struct
+{
+    char line[LEN_STD_STR];
+    unsigned rec_idx;   // the CR
+    double t_cr;        // virtual us
+    double t_done;
+} tReplayCmd;
+
+static tRecord *records = NULL;
+static unsigned num_records = 0;
+
+static tCli cli;
+static double byte_us = 0;
+static double speed = 1;
+static double t_now = 0;        // virtual us
+static double t_last_rx = -1e30;
+static unsigned rx_next = 0;
+static unsigned long rx_bytes = 0;
+static unsigned long tx_bytes = 0;
+static char is_tx_enabled = 0;
+static char is_started = 0;     // first Rx fed, Tx before it belongs to "capture on"
+
+static unsigned long byte_max[2] = { 0 };  // slowest Rx and Tx byte, in ns
+static unsigned num_over_budget = 0;
+
+static char *tx_out = NULL;
+static unsigned long tx_out_len = 0;
+
+static tReplayCmd cmds[MAX_REPLAY_CMDS];
+static unsigned num_cmds = 0;
+static int open_cmd = -1;
+
+static int ReplayHex(int c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+
+    return -1;
+}
+
+/* Hex of the last dump in the file, back to raw ring bytes */
+static unsigned char* ReplayLoadDump(FILE *file, unsigned *len)
+{
+    char text[4096];
+    unsigned char *ring = NULL;
+    unsigned cap = 0;
+    int is_in_dump = 0;
+
+    *len = 0;
+    while (fgets(text, sizeof(text), file))
+    {
+        char *hex = text;
+
+        if (strstr(text, "capture: "))
+        {
+            is_in_dump = 1;  // a newer dump starts over
+            *len = 0;
+            continue;
+        }
+
+        if (!is_in_dump || text[0] != ':' || ReplayHex((unsigned char)text[1]) < 0)
+        {
+            is_in_dump = 0;
+            continue;
+        }
+
+        for (++hex; ReplayHex((unsigned char)hex[0]) >= 0 && ReplayHex((unsigned char)hex[1]) >= 0; hex += 2)
+        {
+            if (*len == cap)
+            {
+                cap = cap ? 2 * cap : 1024;
+                ring = realloc(ring, cap);
+            }
+            ring[(*len)++] = ReplayHex((unsigned char)hex[0]) << 4 | ReplayHex((unsigned char)hex[1]);
+        }
+    }
+
+    return ring;
+}
+
+static int ReplayDecode(const unsigned char *ring, unsigned len)
+{
+    double t_ms = 0;
+
+    records = calloc(len / 2 + 1, sizeof(tRecord));
+
+    for (unsigned i = 0; i < len; )
+    {
+        unsigned long delta = ring[i] & ~CAPTURE_TX;
+        char is_tx = (ring[i++] & CAPTURE_TX) != 0;
+
+        if (delta == CAPTURE_LONG)
+        {
+            delta = 0;
+            for (unsigned shift = 0; i < len; shift += 7)
+            {
+                delta |= (unsigned long)(ring[i] & 0x7F) << shift;
+                if (!(ring[i++] & 0x80))
+                {
+                    break;
+                }
+            }
+        }
+
+        if (i >= len)
+        {
+            return -1;  // cut short
+        }
+
+        t_ms += num_records ? delta : 0;
+        records[num_records].t_ms = t_ms;
+        records[num_records].is_tx = is_tx;
+        records[num_records++].c = ring[i++];
+    }
+
+    return 0;
+}
+
+/* When the next Rx byte arrives, in virtual us */
+static double ReplayRxTime(unsigned idx)
+{
+    double t = speed > 0 ? records[idx].t_ms * 1000 / speed : 0;
+
+    return t > t_last_rx + byte_us ? t : t_last_rx + byte_us;
+}
+
+/* CliRxChar with *c, or CliTxChar, as the ISR. The hooks they call only set flags, and capture
+ * records a retimed byte again, which the replay doesn't read back */
+static int ReplayIsr(int is_tx, char *c)
+{
+    tCli before = cli;
+    unsigned long t_byte = ~0UL;
+    unsigned long t_run = 0;
+    int retval = 0;
+
+    CliHostSetIsr(1);
+    for (int run = 0; run < REPLAY_BUDGET_RUNS && t_byte > CLI_ISR_BUDGET; ++run)
+    {
+        cli = before;
+        t_run = CliGetCycles();
+        retval = is_tx ? CliTxChar(&cli, c) : CliRxChar(&cli, *c);
+        t_run = CliGetCycles() - t_run;
+        t_byte = t_run < t_byte ? t_run : t_byte;
+    }
+    CliHostSetIsr(0);
+
+    byte_max[is_tx] = t_byte > byte_max[is_tx] ? t_byte : byte_max[is_tx];
+    num_over_budget += t_byte > CLI_ISR_BUDGET;
+
+    return retval;
+}
+
+static void ReplayFeedDue(void)
+{
+    char was_line = 0;
+    char c = 0;
+
+    for (;;)
+    {
+        while (rx_next < num_records && records[rx_next].is_tx)
+        {
+            ++rx_next;
+        }
+
+        if (rx_next == num_records || ReplayRxTime(rx_next) > t_now)
+        {
+            break;
+        }
+
+        t_last_rx = ReplayRxTime(rx_next);
+        is_started = 1;
+        ++rx_bytes;
+
+        was_line = cli.was_input_received;
+
+        c = records[rx_next].c;
+        ReplayIsr(0, &c);
+
+        if (!was_line && cli.was_input_received && num_cmds < MAX_REPLAY_CMDS)
+        {
+            memcpy(cmds[num_cmds].line, cli.line, LEN_STD_STR);
+            cmds[num_cmds].line[LEN_STD_STR - 1] = 0;
+            cmds[num_cmds].rec_idx = rx_next;
+            cmds[num_cmds].t_cr = t_last_rx;
+            cmds[num_cmds].t_done = -1;
+            open_cmd = num_cmds++;
+        }
+
+        ++rx_next;
+    }
+}
+
+static int ReplayTxByte(void)
+{
+    char c = 0;
+    int retval = 0;
+
+    retval = ReplayIsr(1, &c);
+
+    if (retval)
+    {
+        t_now += byte_us;
+        ++tx_bytes;
+
+        if (is_started)
+        {
+            if (!(tx_out_len & 4095))
+            {
+                tx_out = realloc(tx_out, tx_out_len + 4096);
+            }
+            tx_out[tx_out_len++] = c;
+        }
+    }
+
+    return retval;
+}
+
+static void ReplayEnable(void)
+{
+    is_tx_enabled = 1;
+
+    if (!CliIsInIsr())
+    {
+        /* a callback: the Tx ISR drains while it waits, Rx keeps arriving meanwhile */
+        while (ReplayTxByte())
+        {
+            ReplayFeedDue();
+        }
+    }
+}
+
+static void ReplayDisable(void)
+{
+    is_tx_enabled = 0;
+}
+
+static void ReplayTxIdle(void)
+{
+    if (open_cmd >= 0 && !cli.was_input_received)
+    {
+        cmds[open_cmd].t_done = t_now;
+        open_cmd = -1;
+    }
+}
+
+static void ReplayPrintEscaped(const char *data, unsigned long len)
+{
+    for (unsigned long i = 0; i < len; ++i)
+    {
+        unsigned char c = data[i];
+
+        if (c >= ' ' && c < 127 && c != '\\')
+        {
+            putchar(c);
+        }
+        else
+        {
+            printf("\\x%02X", c);
+        }
+    }
+}
+
+static void ReplayReport(void)
+{
+    char *rec_tx = malloc(num_records + 1);
+    unsigned long rec_tx_len = 0;
+    unsigned long diff = 0;
+    int is_tx_recorded = 0;
+    int is_seen_rx = 0;
+
+    printf("replay: %lu B rx, %lu B tx, %.1f ms at %.0f baud, speed %g\n",
+           rx_bytes, tx_bytes, t_now / 1000, 10e6 / byte_us, speed);
+    printf("drops: %u rx, %u tx\n", cli.rx_drops, cli.tx_drops);
+    printf("per byte: rx max %lu ns, tx max %lu ns, %u over %u\n",
+           byte_max[0], byte_max[1], num_over_budget, CLI_ISR_BUDGET);
+
+    printf("\n%-32s %12s %12s\n", "command", "recorded ms", "replay ms");
+    for (unsigned i = 0; i < num_cmds; ++i)
+    {
+        double t_rec = -1;
+
+        /* recorded: CR to the last Tx before the next Rx */
+        for (unsigned j = cmds[i].rec_idx + 1; j < num_records && records[j].is_tx; ++j)
+        {
+            t_rec = records[j].t_ms - records[cmds[i].rec_idx].t_ms;
+        }
+
+        printf("%-32.32s ", cmds[i].line);
+        t_rec >= 0 ? printf("%12.1f ", t_rec) : printf("%12s ", "-");
+        cmds[i].t_done >= 0 ? printf("%12.3f\n", (cmds[i].t_done - cmds[i].t_cr) / 1000) : printf("%12s\n", "-");
+    }
+
+    for (unsigned i = 0; i < num_records; ++i)
+    {
+        is_seen_rx |= !records[i].is_tx;
+        is_tx_recorded |= records[i].is_tx;
+        if (records[i].is_tx && is_seen_rx)
+        {
+            rec_tx[rec_tx_len++] = records[i].c;
+        }
+    }
+
+    if (!is_tx_recorded)
+    {
+        printf("\ntx: not recorded (capture on -t)\n");
+        free(rec_tx);
+        return;
+    }
+
+    for (diff = 0; diff < rec_tx_len && diff < tx_out_len && rec_tx[diff] == tx_out[diff]; ++diff);
+
+    if (diff == rec_tx_len)
+    {
+        printf("\ntx: identical, %lu B", rec_tx_len);
+        if (tx_out_len > rec_tx_len)
+        {
+            printf(" (the replay sent %lu B more after the recording ended)", tx_out_len - rec_tx_len);
+        }
+        printf("\n");
+    }
+    else
+    {
+        unsigned long from = diff > LEN_DIFF_CONTEXT ? diff - LEN_DIFF_CONTEXT : 0;
+
+        printf("\ntx: differs at byte %lu of %lu (replay sent %lu)\n", diff, rec_tx_len, tx_out_len);
+        printf("  recorded: \"");
+        ReplayPrintEscaped(rec_tx + from, (rec_tx_len < diff + LEN_DIFF_CONTEXT ? rec_tx_len : diff + LEN_DIFF_CONTEXT) - from);
+        printf("\"\n  replay:   \"");
+        ReplayPrintEscaped(tx_out + from, (tx_out_len < diff + LEN_DIFF_CONTEXT ? tx_out_len : diff + LEN_DIFF_CONTEXT) - from);
+        printf("\"\n");
+    }
+
+    free(rec_tx);
+}
+
+int main(int argc, char **argv)
+{
+    double baud = 115200;
+    const char *path = NULL;
+    unsigned char *ring = NULL;
+    unsigned len = 0;
+    FILE *file = NULL;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!strcmp(argv[i], "--baud") && i + 1 < argc)
+        {
+            baud = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--speed") && i + 1 < argc)
+        {
+            speed = atof(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && !path)
+        {
+            path = argv[i];
+        }
+        else
+        {
+            path = NULL;
+            break;
+        }
+    }
+
+    if (!path || baud <= 0 || speed < 0)
+    {
+        fprintf(stderr, "usage: %s [--baud <bit/s>] [--speed <factor, 0: back to back>] <log with a capture dump>\n", argv[0]);
+        return 1;
+    }
+
+    if (!(file = fopen(path, "r")))
+    {
+        perror(path);
+        return 1;
+    }
+    ring = ReplayLoadDump(file, &len);
+    fclose(file);
+
+    if (!len || ReplayDecode(ring, len))
+    {
+        fprintf(stderr, "%s: no complete capture dump\n", path);
+        return 1;
+    }
+
+    byte_us = 10e6 / baud;  // 8N1
+
+    cli.EnableUartInt = ReplayEnable;
+    cli.DisableUartInt = ReplayDisable;
+    cli.TxIdle = ReplayTxIdle;
+    rx_next = num_records;  // nothing arrives before the first prompt is out
+    CliAddSession(&cli);
+    rx_next = 0;
+    t_now = 0;
+
+    while (rx_next < num_records || is_tx_enabled || cli.was_input_received)
+    {
+        if (cli.was_input_received)
+        {
+            CliHandleSession(&cli);
+            ReplayTxIdle();  // if its output is already out
+        }
+        else if (is_tx_enabled)
+        {
+            ReplayTxByte();
+            ReplayFeedDue();
+        }
+        else
+        {
+            while (rx_next < num_records && records[rx_next].is_tx)
+            {
+                ++rx_next;
+            }
+            if (rx_next < num_records && ReplayRxTime(rx_next) > t_now)
+            {
+                t_now = ReplayRxTime(rx_next);  // idle until the next byte
+            }
+            ReplayFeedDue();
+        }
+    }
+
+    ReplayReport();
+
+    free(ring);
+    free(records);
+    free(tx_out);
+
+    return num_over_budget ? 2 : 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * cli_server.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2021 Wesley Becker
+ *
+ * Serves the commands of cli/cli_cmds.c on Linux, over any mix of transports at once:
+ *     gcc -Icli cli/cli*.c tools/cli_server.c -o cli_server
+ *     ./cli_server --unix /tmp/cli.sock --tcp 2323 --pty --stdio
+ * then e.g. "socat -,raw,echo=0 UNIX:/tmp/cli.sock", "telnet localhost 2323" or
+ * "screen <pty printed at start>". Each connection is a session of its own.
+ */
+
+#include "cli.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(int argc, char **argv)
+{
+    char pty_name[64] = { 0 };
+
+    if (CliHostInit())
+    {
+        perror("epoll");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; ++i)
+    {
+        int error = 0;
+
+        if (!strcmp(argv[i], "--unix") && i + 1 < argc)
+        {
+            error = CliHostListenUnix(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--tcp") && i + 1 < argc)
+        {
+            error = CliHostListenTcp(atoi(argv[++i]));
+        }
+        else if (!strcmp(argv[i], "--pty"))
+        {
+            error = CliHostOpenPty(pty_name, sizeof(pty_name));
+            if (!error)
+            {
+                fprintf(stderr, "pty: %s\n", pty_name);
+            }
+        }
+        else if (!strcmp(argv[i], "--stdio"))
+        {
+            error = CliHostOpen(STDIN_FILENO, STDOUT_FILENO);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--unix <path>] [--tcp <port>] [--pty] [--stdio]\n", argv[0]);
+            return 1;
+        }
+
+        if (error)
+        {
+            perror(argv[i]);
+            return 1;
+        }
+    }
+
+    for (;;)
+    {
+        CliHostPoll(-1);
+    }
+
+    return 0;
+}
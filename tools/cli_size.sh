@@ -0,0 +1,76 @@
+#!/bin/sh
+#
+# cli_size.sh
+#
+# MIT License
+#
+# Copyright (c) 2021 Wesley Becker
+#
+# Flash and RAM cost of each CLI_CFG_xxx feature (see cli/cli_cfg.h):
+#     CFLAGS="-I<dir with S32K148.h>" tools/cli_size.sh
+#
+# Builds the objects once with every feature off, once with all on, and once per feature,
+# then prints the differences. "ram" is .data + .bss of the objects, tCli (allocated by the
+# application) is shown on its own. Extra -D options in CFLAGS apply to every build, e.g.
+# -DLEN_HISTORY=64. CC and SIZE default to the arm-none-eabi ones.
+
+CC=${CC:-arm-none-eabi-gcc}
+SIZE=${SIZE:-arm-none-eabi-size}
+CFLAGS=${CFLAGS:-}
+CFLAGS="-Os -mcpu=cortex-m4 -mthumb -fno-common -DCLI_CFG_HOST=0 $CFLAGS"
+case $CC in
+    arm-*) ;;
+    *) CFLAGS=$(echo "$CFLAGS" | sed 's/-mcpu=[^ ]*//; s/-mthumb//') ;;  # host compiler
+esac
+
+FEATURES="HISTORY NAVIGATION COMPLETION GROUPS MACROS VARS XFER LATENCY CAPTURE COMPRESS DEBUG"
+SRCS="cli.c cli_cmds.c cli_vars.c cli_xfer.c cli_capture.c cli_lz.c"
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+printf '#include "cli.h"\ntCli cli_size_probe;\n' > "$TMP/probe.c"
+
+# prints "text ram tcli" for the given -D options
+measure()
+{
+    for src in $SRCS; do
+        $CC $CFLAGS "$@" -I"$ROOT/cli" -c "$ROOT/cli/$src" -o "$TMP/${src%.c}.o" || exit 1
+    done
+    $CC $CFLAGS "$@" -I"$ROOT/cli" -c "$TMP/probe.c" -o "$TMP/probe.o" || exit 1
+
+    objs=""
+    for src in $SRCS; do
+        objs="$objs $TMP/${src%.c}.o"
+    done
+
+    $SIZE $objs | awk 'NR > 1 { text += $1; ram += $2 + $3 } END { printf "%d %d ", text, ram }'
+    $SIZE "$TMP/probe.o" | awk 'NR > 1 { print $3 }'
+}
+
+# -D options with every feature off, except those given
+config()
+{
+    for f in $FEATURES; do
+        on=0
+        for g in "$@"; do
+            [ "$f" = "$g" ] && on=1
+        done
+        printf -- '-DCLI_CFG_%s=%d ' "$f" "$on"
+    done
+}
+
+set -- $(measure $(config))
+base_text=$1 base_ram=$2 base_tcli=$3
+
+printf '%-12s %8s %8s %8s\n' feature flash ram tCli
+printf '%-12s %8d %8d %8d\n' core "$base_text" "$base_ram" "$base_tcli"
+
+for f in $FEATURES; do
+    set -- $(measure $(config "$f"))
+    printf '%-12s %+8d %+8d %+8d\n' "$f" $(($1 - base_text)) $(($2 - base_ram)) $(($3 - base_tcli))
+done
+
+set -- $(measure $(config $FEATURES))
+printf '%-12s %8d %8d %8d\n' all "$1" "$2" "$3"
@@ -0,0 +1,248 @@
+#!/usr/bin/env python3
+#
+# cli_xfer.py
+#
+# MIT License
+#
+# Copyright (c) 2021 Wesley Becker
+#
+# Host side of the CLI "load"/"save" commands (see cli/cli_xfer.c for the protocol).
+#
+#   cli_xfer.py /dev/ttyUSB0 load 0x20000000 image.bin [-f] [--window 4] [--baud 115200]
+#   cli_xfer.py /dev/ttyUSB0 save 0x20000000 4096 dump.bin [-f] [--baud 115200]
+#
+# Only needs the standard library (termios), so it runs on Linux and macOS.
+
+import argparse
+import os
+import select
+import sys
+import termios
+import time
+
+SOH, STX, EOT, ACK, NAK, CAN = 0x01, 0x02, 0x04, 0x06, 0x15, 0x18
+CRC_REQ = ord('C')
+PAD = 0x1A
+
+BAUDS = {n: getattr(termios, 'B%d' % n) for n in (9600, 19200, 38400, 57600, 115200, 230400, 460800, 921600)
+         if hasattr(termios, 'B%d' % n)}
+
+
+def crc16(data, crc=0):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+class Port:
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        if os.isatty(self.fd):
+            attr = termios.tcgetattr(self.fd)
+            attr[0] = attr[1] = attr[3] = 0                  # raw iflag, oflag, lflag
+            attr[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+            attr[4] = attr[5] = BAUDS[baud]
+            termios.tcsetattr(self.fd, termios.TCSANOW, attr)
+
+    def write(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def read(self, timeout):
+        """One byte, or None on timeout."""
+        if not select.select([self.fd], [], [], timeout)[0]:
+            return None
+        return os.read(self.fd, 1)[0]
+
+    def read_exact(self, n, timeout):
+        data = bytearray()
+        while len(data) < n:
+            b = self.read(timeout)
+            if b is None:
+                return None
+            data.append(b)
+        return bytes(data)
+
+    def read_text(self, timeout=0.5):
+        data = bytearray()
+        while True:
+            b = self.read(timeout)
+            if b is None:
+                return data.decode(errors='replace')
+            data.append(b)
+
+
+def frame(seq, payload, block):
+    hdr = STX if block == 1024 else SOH
+    payload = payload.ljust(block, bytes([PAD]))
+    crc = crc16(payload)
+    return bytes([hdr, seq & 0xFF, ~seq & 0xFF]) + payload + bytes([crc >> 8, crc & 0xFF])
+
+
+def is_cancel(port, b):
+    """CAN CAN aborts, a single CAN may just be noise."""
+    return b == CAN and port.read(0.1) == CAN
+
+
+def wait_for(port, wanted, timeout):
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        if port.read(deadline - time.monotonic()) == wanted:
+            return True
+    return False
+
+
+def skip_echo(port, cmd, timeout):
+    """Echo of the command, its text could contain the byte waited for next."""
+    echo = bytearray()
+    deadline = time.monotonic() + timeout
+    while not echo.endswith(cmd) and time.monotonic() < deadline:
+        b = port.read(deadline - time.monotonic())
+        if b is not None:
+            echo.append(b)
+
+
+def load(port, args):
+    data = open(args.file, 'rb').read()
+    blocks = [str(len(data)).encode()] + [data[i:i + args.block] for i in range(0, len(data), args.block)]
+
+    cmd = ('load %s%s' % ('-f ' if args.flash else '', args.addr)).encode()
+    port.write(cmd)
+    skip_echo(port, cmd, 2)                 # before the line runs, the transfer holds back text
+    port.write(b'\r')
+    if not wait_for(port, CRC_REQ, 2):
+        sys.exit('no answer to load')
+
+    t_start = time.monotonic()
+    base = nxt = retries = 0
+
+    while base < len(blocks):
+        while nxt < len(blocks) and nxt < base + args.window:
+            port.write(frame(nxt, blocks[nxt], args.block))
+            nxt += 1
+
+        b = port.read(args.timeout)
+        if b is None:
+            retries += 1
+            nxt = base                      # timeout, resend the window
+            continue
+        if is_cancel(port, b):
+            sys.exit('aborted by target')
+        if b not in (ACK, NAK):
+            continue                        # stray bytes between replies
+
+        seq = port.read(args.timeout)
+        if seq is None:
+            continue
+        block = base + ((seq - base) & 0xFF)
+        if block >= nxt:
+            continue
+        if b == ACK:
+            base = block + 1
+        else:
+            retries += 1
+            base = nxt = block
+
+    for _ in range(5):
+        port.write(bytes([EOT]))
+        if wait_for(port, ACK, args.timeout):
+            break
+    else:
+        sys.exit('no ACK for EOT')
+    report('load', len(data), time.monotonic() - t_start, retries, port)
+
+
+def save(port, args):
+    port.write(('save %s%s %s\r' % ('-f ' if args.flash else '', args.addr, args.len)).encode())
+    time.sleep(0.1)
+    port.read_text(0.1)                     # echo
+    port.write(bytes([CRC_REQ]))
+
+    t_start = time.monotonic()
+    expected = retries = 0
+    naked = False                           # NAK once per missing block, then wait for the timeout
+    length = None
+    data = bytearray()
+
+    while True:
+        b = port.read(args.timeout)
+        if b is None:
+            retries += 1
+            naked = True
+            # before block 0 the 'C' may have been lost, or block 0 itself: 'C' is ignored once
+            # the target started sending and NAK 0 is ignored before
+            port.write(bytes([NAK, expected & 0xFF]) if expected else bytes([CRC_REQ, NAK, 0]))
+            continue
+        if is_cancel(port, b):
+            sys.exit('aborted by target')
+        if b == EOT and length is not None and len(data) >= length:
+            port.write(bytes([ACK, 0]))
+            break
+        if b not in (SOH, STX):
+            continue
+
+        size = 1024 if b == STX else 128
+        rest = port.read_exact(size + 4, args.timeout)
+        if rest is None:
+            continue
+        seq, nseq, payload, crc = rest[0], rest[1], rest[2:-2], rest[-2] << 8 | rest[-1]
+        if seq != (~nseq & 0xFF) or crc16(payload) != crc or seq != expected & 0xFF:
+            if crc16(payload) == crc and expected and seq == (expected - 1) & 0xFF:
+                port.write(bytes([ACK, seq]))   # our ACK got lost
+            elif not naked:
+                retries += 1
+                naked = True
+                port.write(bytes([NAK, expected & 0xFF]))
+            continue
+
+        if expected == 0:
+            length = int(payload.split(b'\0')[0])
+        else:
+            data += payload
+        port.write(bytes([ACK, seq]))
+        expected += 1
+        naked = False
+
+    open(args.file, 'wb').write(bytes(data[:length]))
+    report('save', length, time.monotonic() - t_start, retries, port)
+
+
+def report(what, length, seconds, retries, port):
+    rate = length / seconds if seconds else 0
+    print('%s: %d B in %.3f s, %.0f B/s (%.1f%% of %d baud), %d retries'
+          % (what, length, seconds, rate, 100.0 * rate * 10 / port.baud, port.baud, retries))
+    print(port.read_text().strip())     # target's own report
+
+
+def main():
+    # the options go after the command, as in the usage above
+    options = argparse.ArgumentParser(add_help=False)
+    options.add_argument('--baud', type=int, default=115200, choices=sorted(BAUDS))
+    options.add_argument('--window', type=int, default=4, help='blocks in flight on load')
+    options.add_argument('--block', type=int, default=128, choices=(128, 1024), help='must match LEN_XFER_BLOCK')
+    options.add_argument('--timeout', type=float, default=1.0)
+    options.add_argument('-f', '--flash', action='store_true', help='use the target\'s flash sink')
+
+    parser = argparse.ArgumentParser(description='CLI load/save over a serial port')
+    parser.add_argument('port')
+    sub = parser.add_subparsers(dest='cmd', required=True)
+    p = sub.add_parser('load', parents=[options])
+    p.add_argument('addr')
+    p.add_argument('file')
+    p = sub.add_parser('save', parents=[options])
+    p.add_argument('addr')
+    p.add_argument('len')
+    p.add_argument('file')
+    args = parser.parse_args()
+
+    port = Port(args.port, args.baud)
+    port.baud = args.baud
+    port.read_text(0.1)                     # drop whatever is pending
+    load(port, args) if args.cmd == 'load' else save(port, args)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,157 @@
+#!/usr/bin/env python3
+#
+# gen_esc_table.py
+#
+# MIT License
+#
+# Copyright (c) 2021 Wesley Becker
+#
+# Generates cli/cli_esc_table.h, the key decoder used by CliRxISR:
+#     python3 tools/gen_esc_table.py > cli/cli_esc_table.h
+#
+# Every received byte is first mapped to a class (esc_classes), then
+# esc_transitions[state][class] gives the next state and an action, so decoding costs two
+# table lookups per byte whatever the sequence. Actions that complete a key look the key up in
+# esc_ctrl_keys, esc_alt_keys, esc_final_keys (CSI/SS3 final byte) or esc_tilde_keys (CSI n ~).
+
+# CSI_SKIP swallows a CSI the CLI has no key for (private parameters < = > ?, intermediates
+# 0x20-0x2F) up to its final byte, e.g. a DA reply ESC [ ? 1 ; 2 c or an SGR mouse report
+STATES = ['GROUND', 'ESC', 'CSI', 'SS3', 'CSI_SKIP']
+STATE_BITS = 3
+
+# INTER is 0x20-0x2F, ':' and < = > ?, the CSI bytes besides digits and ';' that aren't final
+CLASSES = ['OTHER', 'CTRL', 'DEL', 'ESC', 'PRINT', 'DIGIT', 'SEMI', 'TILDE', 'LBRCKT', 'O', 'FINAL', 'INTER']
+
+ACTIONS = ['NONE', 'INSERT', 'CTRL', 'ALT', 'CLEAR', 'PARAM', 'NEXT_PARAM', 'CSI', 'TILDE', 'SS3']
+
+KEYS = ['NONE', 'INSERT', 'ENTER', 'TAB', 'BACKSPACE', 'DELETE', 'UP', 'DOWN', 'RIGHT', 'LEFT',
+        'HOME', 'END', 'WORD_LEFT', 'WORD_RIGHT', 'KILL_EOL', 'KILL_BOL', 'KILL_WORD', 'REDRAW', 'ABORT']
+
+CTRL_KEYS = {
+    'A': 'HOME', 'B': 'LEFT', 'C': 'ABORT', 'D': 'DELETE', 'E': 'END', 'F': 'RIGHT', 'H': 'BACKSPACE',
+    'I': 'TAB', 'J': 'ENTER', 'K': 'KILL_EOL', 'L': 'REDRAW', 'M': 'ENTER', 'N': 'DOWN', 'P': 'UP',
+    'U': 'KILL_BOL', 'W': 'KILL_WORD',
+}
+
+ALT_KEYS = {'b': 'WORD_LEFT', 'f': 'WORD_RIGHT', 'B': 'WORD_LEFT', 'F': 'WORD_RIGHT', 0x7F: 'KILL_WORD', 0x08: 'KILL_WORD'}
+
+# CSI/SS3 final bytes, lower case are rxvt's modified arrows
+FINAL_KEYS = {'A': 'UP', 'B': 'DOWN', 'C': 'RIGHT', 'D': 'LEFT', 'H': 'HOME', 'F': 'END',
+              'a': 'UP', 'b': 'DOWN', 'c': 'WORD_RIGHT', 'd': 'WORD_LEFT'}
+
+# CSI n ~ (VT220, rxvt uses 7/8 for home/end)
+TILDE_KEYS = {1: 'HOME', 3: 'DELETE', 4: 'END', 7: 'HOME', 8: 'END'}
+
+# (state, class) -> (next state, action), anything missing drops the sequence silently
+TRANSITIONS = {}
+for c in CLASSES:
+    TRANSITIONS[('GROUND', c)] = ('GROUND', 'INSERT')
+    TRANSITIONS[('ESC', c)] = ('GROUND', 'ALT')
+    TRANSITIONS[('CSI', c)] = ('GROUND', 'NONE')
+    TRANSITIONS[('SS3', c)] = ('GROUND', 'NONE')
+    TRANSITIONS[('CSI_SKIP', c)] = ('GROUND', 'NONE')  # any final byte ends it
+for s in STATES:
+    TRANSITIONS[(s, 'ESC')] = ('ESC', 'NONE')      # a new ESC restarts any sequence
+    TRANSITIONS[(s, 'CTRL')] = ('GROUND', 'CTRL')  # control keys also abort a sequence
+    TRANSITIONS[(s, 'DEL')] = ('GROUND', 'CTRL')
+TRANSITIONS[('ESC', 'DEL')] = ('GROUND', 'ALT')    # Alt-Backspace
+TRANSITIONS[('GROUND', 'OTHER')] = ('GROUND', 'NONE')
+TRANSITIONS[('ESC', 'LBRCKT')] = ('CSI', 'CLEAR')
+TRANSITIONS[('ESC', 'O')] = ('SS3', 'CLEAR')
+TRANSITIONS[('CSI', 'DIGIT')] = ('CSI', 'PARAM')
+TRANSITIONS[('CSI', 'SEMI')] = ('CSI', 'NEXT_PARAM')
+TRANSITIONS[('CSI', 'LBRCKT')] = ('CSI', 'NONE')   # linux console F-keys, ESC [ [ A
+TRANSITIONS[('CSI', 'INTER')] = ('CSI_SKIP', 'NONE')
+TRANSITIONS[('CSI_SKIP', 'DIGIT')] = ('CSI_SKIP', 'NONE')
+TRANSITIONS[('CSI_SKIP', 'SEMI')] = ('CSI_SKIP', 'NONE')
+TRANSITIONS[('CSI_SKIP', 'INTER')] = ('CSI_SKIP', 'NONE')
+TRANSITIONS[('CSI', 'TILDE')] = ('GROUND', 'TILDE')
+TRANSITIONS[('CSI', 'FINAL')] = ('GROUND', 'CSI')
+TRANSITIONS[('CSI', 'O')] = ('GROUND', 'CSI')
+TRANSITIONS[('SS3', 'DIGIT')] = ('SS3', 'PARAM')   # ESC O 5 C on some terminals
+TRANSITIONS[('SS3', 'FINAL')] = ('GROUND', 'SS3')
+TRANSITIONS[('SS3', 'O')] = ('GROUND', 'SS3')
+
+
+def char_class(b):
+    if b == 0x1B:
+        return 'ESC'
+    if b in (0x08, 0x7F):
+        return 'DEL'
+    if b < 0x20:
+        return 'CTRL'
+    if b >= 0x80:
+        return 'OTHER'
+    c = chr(b)
+    if c.isdigit():
+        return 'DIGIT'
+    if c == ';':
+        return 'SEMI'
+    if c == '~':
+        return 'TILDE'
+    if c == '[':
+        return 'LBRCKT'
+    if c == 'O':
+        return 'O'
+    if c.isalpha():
+        return 'FINAL'
+    if b < 0x40:
+        return 'INTER'
+    return 'PRINT'
+
+
+def key(name):
+    return 'eKEY_' + name
+
+
+def rows(values, per_row):
+    values = list(values)
+    return ',\n'.join('    ' + ', '.join(values[i:i + per_row]) for i in range(0, len(values), per_row))
+
+
+def main():
+    assert len(STATES) <= 1 << STATE_BITS and len(ACTIONS) << STATE_BITS <= 256
+
+    out = []
+    out.append('/*\n * cli_esc_table.h\n *\n * Generated by tools/gen_esc_table.py, do not edit.\n *\n */\n')
+    out.append('#ifndef CLI_ESC_TABLE_H_\n#define CLI_ESC_TABLE_H_\n')
+    out.append('enum\n{\n    %s\n};\n' % ', '.join('eESC_' + s for s in STATES))
+    out.append('enum\n{\n    %s, eNUM_CLASSES\n};\n' % ', '.join('eCL_' + c for c in CLASSES))
+    out.append('enum\n{\n    %s\n};\n' % ', '.join('eACT_' + a for a in ACTIONS))
+    out.append('enum\n{\n%s\n};\n' % rows((key(k) for k in KEYS), 6))
+
+    out.append('#define ESC_NEXT(entry) ((entry) & 0x%02X)\n#define ESC_ACTION(entry) ((entry) >> %d)\n'
+               % ((1 << STATE_BITS) - 1, STATE_BITS))
+
+    out.append('static const unsigned char esc_classes[128] =\n{\n%s\n};\n'
+               % rows(('eCL_' + char_class(b) for b in range(128)), 8))
+
+    table = []
+    for s in STATES:
+        entries = []
+        for c in CLASSES:
+            nxt, act = TRANSITIONS[(s, c)]
+            entries.append('eESC_%s | eACT_%s << %d' % (nxt, act, STATE_BITS))
+        table.append('    {   /* eESC_%s */\n%s\n    }' % (s, ',\n'.join('        ' + e for e in entries)))
+    out.append('static const unsigned char esc_transitions[%d][eNUM_CLASSES] =\n{\n%s\n};\n'
+               % (len(STATES), ',\n'.join(table)))
+
+    ctrl = [key(CTRL_KEYS.get(chr(0x40 + b), 'NONE')) for b in range(32)]
+    out.append('static const unsigned char esc_ctrl_keys[32] =  /* DEL (127) is BACKSPACE too */\n{\n%s\n};\n' % rows(ctrl, 6))
+
+    alt = [key(ALT_KEYS.get(chr(b) if 0x20 <= b < 0x7F else b, 'NONE')) for b in range(128)]
+    out.append('static const unsigned char esc_alt_keys[128] =\n{\n%s\n};\n' % rows(alt, 6))
+
+    final = [key(FINAL_KEYS.get(chr(b), 'NONE')) for b in range(0x40, 0x7F)]
+    out.append('#define ESC_FIRST_FINAL 0x40\n')
+    out.append('static const unsigned char esc_final_keys[%d] =\n{\n%s\n};\n' % (len(final), rows(final, 6)))
+
+    tilde = [key(TILDE_KEYS.get(n, 'NONE')) for n in range(max(TILDE_KEYS) + 1)]
+    out.append('static const unsigned char esc_tilde_keys[%d] =\n{\n%s\n};\n' % (len(tilde), rows(tilde, 6)))
+
+    out.append('#endif /* CLI_ESC_TABLE_H_ */')
+    print('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()